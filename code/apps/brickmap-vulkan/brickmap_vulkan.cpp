@@ -68,8 +68,19 @@ namespace rebel_road
         void brickmap_vulkan_app::generate_world()
         {
             voxel_world.reset();
-            voxel_world = voxel::world::create( render_ctx.get() );
-            voxel_world->generate();
+            voxel_world = voxel::world::create( render_ctx.get(), world_dims );
+            voxel_world->set_brick_compression( compress_bricks );
+
+            if ( import_path.empty() || !voxel_world->import_volume( import_path, import_raw_size ) )
+            {
+                // Generating the terrain dominates startup, so reuse the previous world if one was saved.
+                if ( !voxel_world->load( world_path, uint64_t( host_brick_budget_mb ) * 1024 * 1024 ) )
+                {
+                    voxel_world->generate();
+                    voxel_world->save( world_path );
+                }
+            }
+
             ray_tracer->bind_world( voxel_world );
         }
 
@@ -121,6 +132,7 @@ namespace rebel_road
             float delta_time = glfwGetTime() - previous_time;
             previous_time = glfwGetTime();
 
+            voxel_world->set_focus( camera.position );
             voxel_world->tick( delta_time );
 
             glfwPollEvents();
@@ -194,9 +206,55 @@ namespace rebel_road
             {
                 uint64_t bricks = voxel_world->get_filled_voxel_count()/uint64_t(brick_size);
                 ImGui::Text( "World" );
-                ImGui::Text( "Chunks: %i, Cells: %i, Bricks: %llu", chunk_count, cells, bricks );
+                const auto& dims = voxel_world->get_dimensions();
+                ImGui::Text( "Size: %ix%ix%i, Chunk Size: %i", dims.grid_size, dims.grid_size, dims.grid_height, dims.chunk_size );
+                ImGui::Text( "Chunks: %i, Cells: %i, Bricks: %llu", dims.get_chunk_count(), dims.get_cells(), bricks );
                 ImGui::Text( "Filled Voxels: %llu", voxel_world->get_filled_voxel_count() );
 
+                const auto& dedup = voxel_world->get_dedup_stats();
+                ImGui::Text( "Stored Bricks: %llu of %llu (%.2fx dedup)", dedup.stored_bricks, dedup.referenced_bricks, dedup.referenced_bricks / double( std::max<uint64_t>( dedup.stored_bricks, 1 ) ) );
+                ImGui::Text( "Solid Bricks: %llu", dedup.solid_bricks );
+                if ( dedup.compressed_bricks > 0 )
+                {
+                    ImGui::Text( "Compressed Bricks: %llu, %llu MB of %llu MB (%.2fx)", dedup.compressed_bricks, dedup.compressed_bytes / ( 1024 * 1024 ),
+                        dedup.compressed_bricks * sizeof( voxel::brick ) / ( 1024 * 1024 ), dedup.compressed_bricks * sizeof( voxel::brick ) / double( std::max<uint64_t>( dedup.compressed_bytes, 1 ) ) );
+                }
+                ImGui::Text( "GPU Brick Uploads: %llu of %llu (%llu KB saved)", dedup.gpu_uploads, dedup.gpu_placements, ( dedup.gpu_placements - dedup.gpu_uploads ) * sizeof( voxel::brick ) / 1024 );
+
+                const auto& heap = voxel_world->get_brick_heap_stats();
+                ImGui::Text( "GPU Brick Heap: %u of %u slots (peak %u, %u retired), %llu refused", heap.used, heap.capacity, heap.high_water, heap.retired, heap.failed_allocations );
+                const auto& streaming = voxel_world->get_streaming_stats();
+                ImGui::Text( "Materials: %llu MB, %llu multi-material bricks, GPU blocks %u of %u (peak %u), %llu refused", dedup.material_bytes / ( 1024 * 1024 ), dedup.multi_material_bricks,
+                    streaming.material_blocks.used, streaming.material_blocks.capacity, streaming.material_blocks.high_water, streaming.material_blocks.failed_allocations );
+                ImGui::Text( "Streaming: %llu frames serviced, %.2f ms last frame, %llu throttled", streaming.frames, streaming.service_ms, streaming.throttled_loads );
+                ImGui::Text( "Uploads: %.0f bricks/s, %.2f MB/s, %.1f bytes per brick", streaming.uploads_per_second, streaming.upload_bytes_per_second / ( 1024.0 * 1024.0 ),
+                    streaming.upload_bytes / double( std::max<uint64_t>( streaming.gpu_uploads, 1 ) ) );
+                const auto& residency = voxel_world->get_residency_stats();
+                ImGui::Text( "Evictions: %llu in %llu passes (last %.2f ms), Reloads: %llu, Deferred: %llu", residency.evictions, residency.eviction_passes, residency.last_pass_ms, residency.reloads, residency.deferred_loads );
+                if ( ImGui::SliderInt( "GPU Budget (MB)", &gpu_brick_budget_mb, 1, int( gpu_brick_heap_capacity * sizeof( voxel::brick ) / ( 1024 * 1024 ) ) ) )
+                {
+                    voxel_world->set_gpu_brick_budget( uint32_t( uint64_t( gpu_brick_budget_mb ) * 1024 * 1024 / sizeof( voxel::brick ) ) );
+                }
+                if ( ImGui::SliderInt( "Request Capacity", &request_capacity, 1, brick_load_queue_size ) )
+                {
+                    voxel_world->set_request_capacity( uint32_t( request_capacity ) );
+                }
+                if ( ImGui::SliderInt( "Uploads per Frame", &upload_budget, 1, brick_load_queue_size ) )
+                {
+                    voxel_world->set_upload_budget( uint32_t( upload_budget ) );
+                }
+
+                if ( const auto* paging = voxel_world->get_paging_stats() )
+                {
+                    ImGui::Text( "Paging: %u chunks, %llu MB resident", paging->resident_chunks, paging->resident_bytes / ( 1024 * 1024 ) );
+                    ImGui::Text( "Hits: %llu, Misses: %llu, Page Ins: %llu, Evictions: %llu, Failed Reads: %llu", paging->hits, paging->misses, paging->page_ins, paging->evictions, paging->failed_reads );
+                    ImGui::Text( "Brick compression is off while paging." );
+                    if ( ImGui::SliderInt( "Host Budget (MB)", &host_brick_budget_mb, 64, 16384 ) )
+                    {
+                        voxel_world->set_paging_budget( uint64_t( host_brick_budget_mb ) * 1024 * 1024 );
+                    }
+                }
+
                 ImGui::Separator();
                 ImGui::Text( "Perf" );
                 ImGui::Text( "Average: %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate );
@@ -216,8 +274,97 @@ namespace rebel_road
 
                 ImGui::Separator();
                 ImGui::Text( "Render" );
-                std::vector<const char*> render_modes = { "Sun Rays", "Extend Only", "Normals", "Iterations" };
+                std::vector<const char*> render_modes = { "Sun Rays", "Extend Only", "Normals", "Iterations", "Iterations, Every Cell", "Iterations, Without Distances" };
                 ImGui::Combo( "Mode", &render_mode, render_modes.data(), render_modes.size());
+                if ( render_mode >= 3 )
+                {
+                    ImGui::Text( "Iterations: %.1f per ray", ray_tracer->get_average_iterations() );
+                }
+                ImGui::Text( "" );
+
+                ImGui::Separator();
+                ImGui::Text( "Benchmarks" );
+                if ( ImGui::Button( "Voxelize" ) )
+                {
+                    voxelize_benchmark = voxel::benchmark_voxelize();
+                }
+                if ( voxelize_benchmark.bricks > 0 )
+                {
+                    ImGui::Text( "%u bricks: per voxel %.2f ms, scalar %.2f ms, AVX2 %.2f ms", voxelize_benchmark.bricks, voxelize_benchmark.per_voxel_ms, voxelize_benchmark.scalar_ms, voxelize_benchmark.avx2_ms );
+                }
+                if ( ImGui::Button( "Brick Placement" ) )
+                {
+                    placement_benchmark = voxel_world->benchmark_placement();
+                }
+                if ( placement_benchmark.ticks > 0 )
+                {
+                    ImGui::Text( "%u bricks x %u ticks: %.3f ms, %.1f M bricks/s, %.1f bytes per brick%s", placement_benchmark.bricks_per_tick, placement_benchmark.ticks, placement_benchmark.gpu_ms,
+                        placement_benchmark.bricks_per_second / 1'000'000.0, placement_benchmark.payload_bytes_per_brick, placement_benchmark.verified ? "" : " (MISMATCH)" );
+                }
+                if ( ImGui::Button( "Brick Codec" ) )
+                {
+                    codec_benchmark = voxel_world->benchmark_brick_codec();
+                }
+                if ( codec_benchmark.bricks > 0 )
+                {
+                    ImGui::Text( "%u bricks: %.2fx, encode %.2f ms, decode %.2f ms, %.1f M bricks/s%s", codec_benchmark.bricks,
+                        codec_benchmark.raw_bytes / double( std::max<uint64_t>( codec_benchmark.packed_bytes, 1 ) ), codec_benchmark.encode_ms, codec_benchmark.decode_ms,
+                        codec_benchmark.decoded_bricks_per_second / 1'000'000.0, codec_benchmark.verified ? "" : " (MISMATCH)" );
+                }
+                if ( ImGui::Button( "Cell Distances" ) )
+                {
+                    distance_benchmark = voxel::benchmark_cell_distance_field();
+                }
+                if ( distance_benchmark.cells > 0 )
+                {
+                    ImGui::Text( "%llu cells: build %.2f ms, brute force %.2f ms, %u updates%s", distance_benchmark.cells, distance_benchmark.build_ms, distance_benchmark.brute_force_ms,
+                        distance_benchmark.updates, distance_benchmark.verified ? "" : " (MISMATCH)" );
+                }
+                if ( ImGui::Button( "Regenerate Nearby Chunks" ) )
+                {
+                    const glm::ivec3 center = glm::ivec3( camera.position ) / ( brick_size * voxel_world->get_dimensions().chunk_size );
+                    voxel_world->regenerate_region( center - 1, center + 1 );
+                }
+                if ( ImGui::Button( "Clear Around Camera" ) )
+                {
+                    const glm::ivec3 center = glm::ivec3( camera.position );
+                    voxel_world->edit_region( center - 12, center + 12, false );
+                }
+                ImGui::SameLine();
+                if ( ImGui::Button( "Carve Sphere" ) )
+                {
+                    voxel_world->edit_sphere( camera.position, 24.0f, false );
+                }
+                ImGui::SameLine();
+                if ( ImGui::Button( "Fill Sphere" ) )
+                {
+                    voxel_world->edit_sphere( camera.position + camera.direction * 48.0f, 16.0f, true, uint8_t( fill_material ) );
+                }
+                ImGui::SameLine();
+                if ( ImGui::Button( "Drill Cylinder" ) )
+                {
+                    voxel_world->edit_cylinder( camera.position - glm::vec3( 0.0f, 0.0f, 64.0f ), 8.0f, 128.0f, false );
+                }
+                ImGui::SliderInt( "Fill Material", &fill_material, 0, voxel::material_count - 1 );
+                ImGui::SameLine();
+                const ImVec4 fill_color = ImGui::ColorConvertU32ToFloat4( voxel_world->get_material_colors()[fill_material] );
+                ImGui::ColorButton( "##fill_color", fill_color, ImGuiColorEditFlags_NoTooltip );
+                const auto& edit_stats = voxel_world->get_streaming_stats().edits;
+                ImGui::Text( "Edits: %llu applied, %u waiting, %u cells patched (%.2f ms), %llu bricks uploaded, %llu copied", edit_stats.edits, edit_stats.deferred_edits,
+                    edit_stats.dirty_cells, edit_stats.last_apply_ms, edit_stats.brick_uploads, edit_stats.copied_bricks );
+                ImGui::Text( "Brushes: last batch %u ops over %u chunks, %llu bricks, %.3f ms per op", edit_stats.last_batch_edits, edit_stats.last_batch_chunks, edit_stats.last_batch_bricks,
+                    edit_stats.last_batch_edits > 0 ? edit_stats.last_apply_ms / edit_stats.last_batch_edits : 0.0 );
+                const auto& distance_stats = voxel_world->get_cell_distance_stats();
+                ImGui::Text( "Cell Distances: %.1f ms to build, %.1f MB, %.2f cells average, edits moved %llu of %llu cells in %.2f ms", distance_stats.build_ms,
+                    distance_stats.memory_bytes / ( 1024.0 * 1024.0 ), distance_stats.average_distance, edit_stats.distance_changes, edit_stats.distance_cells, edit_stats.last_distance_ms );
+                const auto heightmap_stats = voxel_world->get_heightmap_stats();
+                ImGui::Text( "Heightmap Tiles: %llu generated, %llu lookups", heightmap_stats.generated, heightmap_stats.lookups );
+                const auto& import_stats = voxel_world->get_import_stats();
+                if ( import_stats.source_voxels > 0 )
+                {
+                    ImGui::Text( "Import: %dx%dx%d, %llu filled, read %.1f ms, build %.1f ms, %.1f M voxels/s", import_stats.size.x, import_stats.size.y, import_stats.size.z,
+                        import_stats.filled_voxels, import_stats.read_ms, import_stats.build_ms, import_stats.voxels_per_second / 1'000'000.0 );
+                }
                 ImGui::Text( "" );
                 
                 ImGui::Separator();
@@ -5,6 +5,7 @@
 #include "imgui/imgui_context.h"
 #include "voxel/ray_tracer.h"
 #include "voxel/world.h"
+#include "voxel/voxelize.h"
 
 namespace rebel_road
 {
@@ -44,6 +45,22 @@ namespace rebel_road
             bool enable_shadows { true };
             int render_mode {};
 
+            voxel::world_dimensions world_dims;
+            std::string world_path { "world.bmap" };
+            std::string import_path {};                     // A .vox file or raw grid to build the world from instead of terrain. Empty to generate.
+            glm::ivec3 import_raw_size {};                  // Size of a raw grid in voxels.
+            int host_brick_budget_mb { 0 };                 // Host memory budget for paged bricks of a loaded world. 0 maps the whole file, for worlds that fit in memory.
+            bool compress_bricks { true };                  // Keep host bricks compressed, decoding them as the GPU requests them. Paged worlds read bricks from disk as they are.
+            int gpu_brick_budget_mb { 128 };                // GPU memory budget for resident bricks.
+            int request_capacity { brick_default_request_capacity };    // Brick requests a trace may queue.
+            int upload_budget { brick_default_request_capacity };       // Bricks uploaded per serviced frame.
+            int fill_material { voxel::terrain_material_rock };         // Material of the voxels filled by edits.
+
+            voxel::voxelize_benchmark_result voxelize_benchmark;
+            voxel::placement_benchmark_result placement_benchmark;
+            voxel::brick_codec_benchmark_result codec_benchmark;
+            voxel::cell_distance_benchmark_result distance_benchmark;
+
             vk::RenderPass render_pass;
             std::vector<vk::Framebuffer> framebuffers;
 
@@ -26,6 +26,9 @@ namespace rebel_road
         {
             device_ctx->device.waitIdle();
             deletion_queue.flush();
+
+            jobs::job_system_locator::provide( nullptr );
+            job_sys.reset();
         }
 
         void vulkan_app::init( std::string in_app_name, uint32_t width, uint32_t height, bool in_use_validation_layers )
@@ -36,10 +39,17 @@ namespace rebel_road
             window_extent = vk::Extent2D( width, height );
 
             init_logging();
+            init_jobs();
             create_window();
             init_vulkan();
         }
 
+        void vulkan_app::init_jobs()
+        {
+            job_sys = jobs::job_system::create();
+            jobs::job_system_locator::provide( job_sys.get() );
+        }
+
         void vulkan_app::init_logging()
         {
             spdlog::set_default_logger( spdlog::stdout_color_mt( "console" ) );
@@ -3,6 +3,7 @@
 #include "containers/deletion_queue.h"
 #include "vulkan/device_context.h"
 #include "vulkan/render_context.h"
+#include "jobs/job_system.h"
 
 namespace rebel_road
 {
@@ -24,6 +25,7 @@ namespace rebel_road
         protected:
             void init( std::string in_app_name, uint32_t width, uint32_t height, bool in_use_validation_layers );
             void init_logging();
+            void init_jobs();
             void create_window();
             void init_vulkan();
             virtual void shutdown();
@@ -34,6 +36,8 @@ namespace rebel_road
 
             util::deletion_queue deletion_queue;
 
+            std::unique_ptr<jobs::job_system> job_sys;
+
             GLFWwindow* window { nullptr };
 
             std::unique_ptr<vulkan::device_context> device_ctx;
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace rebel_road
+{
+    namespace util
+    {
+        // Fixed size ring buffer for one producer thread and one consumer thread. push and pop never block or allocate.
+        template<typename T, size_t capacity>
+        class spsc_queue
+        {
+        public:
+            // Returns false, dropping the item, when the queue is full.
+            bool push( const T& item )
+            {
+                const size_t tail = write_index.load( std::memory_order_relaxed );
+                const size_t next = ( tail + 1 ) % slots;
+                if ( next == read_index.load( std::memory_order_acquire ) )
+                {
+                    return false;
+                }
+
+                items[tail] = item;
+                write_index.store( next, std::memory_order_release );
+                return true;
+            }
+
+            // Returns false when the queue is empty.
+            bool pop( T& out )
+            {
+                const size_t head = read_index.load( std::memory_order_relaxed );
+                if ( head == write_index.load( std::memory_order_acquire ) )
+                {
+                    return false;
+                }
+
+                out = items[head];
+                read_index.store( ( head + 1 ) % slots, std::memory_order_release );
+                return true;
+            }
+
+            // Pops everything queued, leaving the newest item in out. Returns false if there was nothing.
+            bool pop_latest( T& out )
+            {
+                bool popped = false;
+                while ( pop( out ) )
+                {
+                    popped = true;
+                }
+                return popped;
+            }
+
+        private:
+            // One slot stays empty to tell a full queue from an empty one.
+            constexpr static size_t slots = capacity + 1;
+
+            std::array<T, slots> items {};
+            alignas( 64 ) std::atomic<size_t> read_index {};
+            alignas( 64 ) std::atomic<size_t> write_index {};
+        };
+    }
+}
@@ -0,0 +1,134 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace rebel_road
+{
+    namespace io
+    {
+        std::shared_ptr<mapped_file> mapped_file::create( const std::string& path )
+        {
+            return std::make_shared<mapped_file>( path );
+        }
+
+#ifdef _WIN32
+
+        mapped_file::mapped_file( const std::string& path )
+        {
+            HANDLE file = CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+            if ( file == INVALID_HANDLE_VALUE )
+            {
+                return;
+            }
+            file_handle = file;
+
+            LARGE_INTEGER file_size {};
+            if ( !GetFileSizeEx( file, &file_size ) || file_size.QuadPart == 0 )
+            {
+                close();
+                return;
+            }
+
+            // PAGE_WRITECOPY / FILE_MAP_COPY give us a private, writable view of a read only file.
+            HANDLE mapping = CreateFileMappingA( file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr );
+            if ( !mapping )
+            {
+                close();
+                return;
+            }
+            mapping_handle = mapping;
+
+            void* view = MapViewOfFile( mapping, FILE_MAP_COPY, 0, 0, 0 );
+            if ( !view )
+            {
+                close();
+                return;
+            }
+
+            data = static_cast<std::byte*>( view );
+            size = static_cast<size_t>( file_size.QuadPart );
+        }
+
+        void mapped_file::close()
+        {
+            if ( data )
+            {
+                UnmapViewOfFile( data );
+            }
+            if ( mapping_handle )
+            {
+                CloseHandle( mapping_handle );
+            }
+            if ( file_handle )
+            {
+                CloseHandle( file_handle );
+            }
+
+            data = nullptr;
+            size = 0;
+            mapping_handle = nullptr;
+            file_handle = nullptr;
+        }
+
+#else
+
+        mapped_file::mapped_file( const std::string& path )
+        {
+            file_descriptor = open( path.c_str(), O_RDONLY );
+            if ( file_descriptor < 0 )
+            {
+                return;
+            }
+
+            struct stat file_stat {};
+            if ( fstat( file_descriptor, &file_stat ) != 0 || file_stat.st_size == 0 )
+            {
+                close();
+                return;
+            }
+
+            // MAP_PRIVATE gives us a copy-on-write view of a read only file.
+            void* view = mmap( nullptr, file_stat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file_descriptor, 0 );
+            if ( view == MAP_FAILED )
+            {
+                close();
+                return;
+            }
+
+            data = static_cast<std::byte*>( view );
+            size = static_cast<size_t>( file_stat.st_size );
+        }
+
+        void mapped_file::close()
+        {
+            if ( data )
+            {
+                munmap( data, size );
+            }
+            if ( file_descriptor >= 0 )
+            {
+                ::close( file_descriptor );
+            }
+
+            data = nullptr;
+            size = 0;
+            file_descriptor = -1;
+        }
+
+#endif
+
+        mapped_file::~mapped_file()
+        {
+            close();
+        }
+    }
+}
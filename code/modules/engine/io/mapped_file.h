@@ -0,0 +1,54 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+namespace rebel_road
+{
+    namespace io
+    {
+        // A file mapped into the address space of the process.
+        // The mapping is copy-on-write: writes through the view are private to the process and never reach the file.
+        class mapped_file
+        {
+        public:
+            static std::shared_ptr<mapped_file> create( const std::string& path );
+
+            ~mapped_file();
+            mapped_file() = delete;
+            mapped_file( const std::string& path );
+
+            mapped_file( const mapped_file& ) = delete;
+            mapped_file& operator=( const mapped_file& ) = delete;
+
+            bool is_open() const { return data != nullptr; }
+            size_t get_size() const { return size; }
+            std::byte* get_data() const { return data; }
+
+            // Returns a typed pointer into the mapping, or nullptr if count elements at offset would run past the end of the file.
+            template<typename T>
+            T* at( size_t offset, size_t count = 1 ) const
+            {
+                if ( !data || offset > size || count * sizeof( T ) > size - offset )
+                {
+                    return nullptr;
+                }
+
+                return reinterpret_cast<T*>( data + offset );
+            }
+
+        private:
+            void close();
+
+            std::byte* data {};
+            size_t size {};
+
+#ifdef _WIN32
+            void* file_handle {};
+            void* mapping_handle {};
+#else
+            int file_descriptor { -1 };
+#endif
+        };
+    }
+}
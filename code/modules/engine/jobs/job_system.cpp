@@ -0,0 +1,179 @@
+#include "job_system.h"
+
+namespace rebel_road
+{
+    template<> jobs::job_system* service_locator<jobs::job_system>::service {};
+
+    namespace jobs
+    {
+        namespace
+        {
+            // The queue owned by the current thread, if it is a worker of owner.
+            thread_local const job_system* owner {};
+            thread_local uint32_t owned_queue {};
+        }
+
+        std::unique_ptr<job_system> job_system::create( uint32_t worker_count )
+        {
+            if ( worker_count == 0 )
+            {
+                worker_count = std::max( std::thread::hardware_concurrency(), 2u ) - 1;
+            }
+            return std::make_unique<job_system>( worker_count );
+        }
+
+        job_system::job_system( uint32_t worker_count )
+        {
+            for ( uint32_t i = 0; i < worker_count + 1; i++ )
+            {
+                queues.push_back( std::make_unique<worker_queue>() );
+            }
+
+            for ( uint32_t i = 0; i < worker_count; i++ )
+            {
+                workers.emplace_back( [this, i] () { worker_loop( i ); } );
+            }
+
+            spdlog::info( "Job system started with {} workers.", worker_count );
+        }
+
+        job_system::~job_system()
+        {
+            {
+                std::lock_guard lock( sleep_mutex );
+                quit = true;
+            }
+            wake.notify_all();
+
+            for ( auto& worker : workers )
+            {
+                worker.join();
+            }
+        }
+
+        void job_system::submit( std::function<void()> function, task_group* group )
+        {
+            if ( group )
+            {
+                group->pending.fetch_add( 1, std::memory_order_relaxed );
+            }
+
+            // Workers push to their own queue so nested jobs stay hot in cache. Everyone else shares the last queue.
+            const uint32_t queue_index = owner == this ? owned_queue : static_cast<uint32_t>( queues.size() - 1 );
+            {
+                auto& queue = *queues[queue_index];
+                std::lock_guard lock( queue.mutex );
+                queue.jobs.push_back( { std::move( function ), group } );
+            }
+
+            queued.fetch_add( 1, std::memory_order_release );
+            {
+                // Pairs with the predicate check in worker_loop so the notify cannot slip in before a worker sleeps.
+                std::lock_guard lock( sleep_mutex );
+            }
+            wake.notify_one();
+        }
+
+        void job_system::wait( task_group& group )
+        {
+            const uint32_t queue_index = owner == this ? owned_queue : static_cast<uint32_t>( queues.size() - 1 );
+            while ( !group.is_done() )
+            {
+                if ( !try_run_one( queue_index ) )
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        void job_system::parallel_for( uint32_t count, uint32_t grain, const std::function<void( uint32_t begin, uint32_t end )>& body )
+        {
+            grain = std::max( grain, 1u );
+
+            task_group group;
+            for ( uint32_t begin = 0; begin < count; begin += grain )
+            {
+                const uint32_t end = std::min( begin + grain, count );
+                submit( [&body, begin, end] () { body( begin, end ); }, &group );
+            }
+            wait( group );
+        }
+
+        void job_system::worker_loop( uint32_t worker_index )
+        {
+            owner = this;
+            owned_queue = worker_index;
+
+            while ( true )
+            {
+                if ( try_run_one( worker_index ) )
+                {
+                    continue;
+                }
+
+                std::unique_lock lock( sleep_mutex );
+                wake.wait( lock, [this] () { return quit || queued.load( std::memory_order_acquire ) > 0; } );
+                if ( quit )
+                {
+                    return;
+                }
+            }
+        }
+
+        bool job_system::try_pop( uint32_t queue_index, job& out )
+        {
+            auto& queue = *queues[queue_index];
+            std::lock_guard lock( queue.mutex );
+            if ( queue.jobs.empty() )
+            {
+                return false;
+            }
+
+            out = std::move( queue.jobs.back() );
+            queue.jobs.pop_back();
+            return true;
+        }
+
+        bool job_system::try_steal( uint32_t thief_index, job& out )
+        {
+            // Start after the thief so workers spread their steals over different victims.
+            const uint32_t queue_count = static_cast<uint32_t>( queues.size() );
+            for ( uint32_t offset = 1; offset < queue_count; offset++ )
+            {
+                auto& queue = *queues[( thief_index + offset ) % queue_count];
+                std::lock_guard lock( queue.mutex );
+                if ( !queue.jobs.empty() )
+                {
+                    out = std::move( queue.jobs.front() );
+                    queue.jobs.pop_front();
+                    stolen.fetch_add( 1, std::memory_order_relaxed );
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool job_system::try_run_one( uint32_t queue_index )
+        {
+            job j;
+            if ( try_pop( queue_index, j ) || try_steal( queue_index, j ) )
+            {
+                run( j );
+                return true;
+            }
+            return false;
+        }
+
+        void job_system::run( job& j )
+        {
+            queued.fetch_sub( 1, std::memory_order_relaxed );
+            j.function();
+            executed.fetch_add( 1, std::memory_order_relaxed );
+
+            if ( j.group )
+            {
+                j.group->pending.fetch_sub( 1, std::memory_order_release );
+            }
+        }
+    }
+}
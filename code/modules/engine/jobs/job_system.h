@@ -0,0 +1,95 @@
+#pragma once
+
+#include "containers/service_locator.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rebel_road
+{
+    namespace jobs
+    {
+        // A set of jobs that can be waited on together.
+        class task_group
+        {
+        public:
+            bool is_done() const { return pending.load( std::memory_order_acquire ) == 0; }
+
+        private:
+            friend class job_system;
+            std::atomic<uint32_t> pending {};
+        };
+
+        struct job_system_stats
+        {
+            uint64_t executed {};
+            uint64_t stolen {};         // Jobs a worker took from another worker's queue.
+        };
+
+        // Work-stealing scheduler. Each worker owns a queue it pushes to and pops from at the back; idle workers steal from the front of other queues.
+        // Threads that wait on a group run queued jobs instead of blocking, so waiting from inside a job is fine.
+        class job_system
+        {
+        public:
+            // worker_count 0 uses one worker per hardware thread, less one for the thread that creates the job system.
+            static std::unique_ptr<job_system> create( uint32_t worker_count = 0 );
+
+            ~job_system();
+            job_system() = delete;
+            job_system( uint32_t worker_count );
+
+            job_system( const job_system& ) = delete;
+            job_system& operator=( const job_system& ) = delete;
+
+            void submit( std::function<void()> job, task_group* group = nullptr );
+
+            // Returns once every job submitted to the group has finished, running other jobs in the mean time.
+            void wait( task_group& group );
+
+            // Calls body( begin, end ) over [0, count) in ranges of at most grain, and waits for all of them.
+            void parallel_for( uint32_t count, uint32_t grain, const std::function<void( uint32_t begin, uint32_t end )>& body );
+
+            uint32_t get_worker_count() const { return static_cast<uint32_t>( workers.size() ); }
+            job_system_stats get_stats() const { return { executed.load(), stolen.load() }; }
+
+        private:
+            struct job
+            {
+                std::function<void()> function;
+                task_group* group {};
+            };
+
+            struct worker_queue
+            {
+                std::mutex mutex;
+                std::deque<job> jobs;
+            };
+
+            void worker_loop( uint32_t worker_index );
+            bool try_pop( uint32_t queue_index, job& out );
+            bool try_steal( uint32_t thief_index, job& out );
+            bool try_run_one( uint32_t queue_index );
+            void run( job& j );
+
+            std::vector<std::unique_ptr<worker_queue>> queues;     // One per worker plus one shared by outside threads.
+            std::vector<std::thread> workers;
+
+            std::mutex sleep_mutex;
+            std::condition_variable wake;
+            std::atomic<uint32_t> queued {};
+            bool quit {};
+
+            std::atomic<uint32_t> next_external_queue {};
+            std::atomic<uint64_t> executed {};
+            std::atomic<uint64_t> stolen {};
+        };
+
+        using job_system_locator = service_locator<job_system>;
+    }
+}
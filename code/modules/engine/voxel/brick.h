@@ -0,0 +1,138 @@
+#pragma once
+
+#include "hash/hash_utils.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+constexpr static int brick_size = 8;
+
+// The amount of uint32_t members holding voxel bit data.
+constexpr static int cell_members = brick_size * brick_size * brick_size / 32;
+
+// Materials, see material.h. A brick has a palette of up to brick_palette_size material ids and, when it uses more than one, a 2 bit palette entry per voxel.
+constexpr static int brick_palette_size = 4;
+constexpr static int material_index_words = brick_size * brick_size * brick_size * 2 / 32;
+constexpr static uint32_t brick_uniform_material = 0xFFFFFFFFu;
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+
+        struct brick
+        {
+            // 8^3 brick of voxels
+            // 1 bit per voxel
+            // array index: ( cell_x + cell_y * brick_size + cell_z * brick_size * brick_size ) / ( sizeof( uint32_t ) * 8 )
+            // bit position: ( cell_x + cell_y * brick_size + cell_z * brick_size * brick_size ) % ( sizeof( uint32_t ) * 8 )
+            // index within chunk: x + y * chunk_size + z * chunk_size * chunk_size
+            // index is 24 bits 0xFFFFFF
+            uint32_t data[cell_members];
+
+            bool operator==( const brick& other ) const = default;
+        };
+
+        struct brick_hash
+        {
+            size_t operator()( const brick& b ) const
+            {
+                size_t seed = 0;
+                for ( uint32_t word : b.data )
+                {
+                    hash_combine( seed, word );
+                }
+                return seed;
+            }
+        };
+
+        // The materials of one CPU brick.
+        struct brick_material
+        {
+            uint32_t palette {};                            // Material ids, entry i in byte i. Entry 0 is the most common among the brick's voxels.
+            uint32_t indices { brick_uniform_material };    // First of the brick's material_index_words in chunk::material_indices, or brick_uniform_material when every voxel is entry 0.
+        };
+
+        // Content addressed brick storage. Identical bricks with identical materials are stored once and share an index.
+        class brick_pool
+        {
+        public:
+            // Returns the index of an identical brick already in the pool, appending the brick if there is none.
+            // indices holds the brick's material_index_words, or is null when every voxel is palette entry 0.
+            uint32_t insert( const brick& b, uint32_t palette = 0, const uint32_t* indices = nullptr )
+            {
+                references++;
+
+                pooled_brick key { b, palette, {} };
+                if ( indices )
+                {
+                    std::copy( indices, indices + material_index_words, key.indices );
+                    key.has_indices = true;
+                }
+
+                auto [it, inserted] = lookup.try_emplace( key, static_cast<uint32_t>( bricks.size() ) );
+                if ( inserted )
+                {
+                    bricks.push_back( b );
+                    materials.push_back( { palette, indices ? static_cast<uint32_t>( material_indices.size() ) : brick_uniform_material } );
+                    if ( indices )
+                    {
+                        material_indices.insert( material_indices.end(), indices, indices + material_index_words );
+                    }
+                }
+                return it->second;
+            }
+
+            // Hands the unique bricks and their materials to the caller and empties the pool.
+            std::vector<brick> take_bricks()
+            {
+                lookup.clear();
+                references = 0;
+                return std::move( bricks );
+            }
+            std::vector<brick_material> take_materials() { return std::move( materials ); }
+            std::vector<uint32_t> take_material_indices() { return std::move( material_indices ); }
+
+            uint64_t get_reference_count() const { return references; }
+            uint64_t get_unique_count() const { return bricks.size(); }
+
+        private:
+            struct pooled_brick
+            {
+                brick voxels;
+                uint32_t palette;
+                uint32_t indices[material_index_words];
+                bool has_indices {};
+
+                bool operator==( const pooled_brick& other ) const = default;
+            };
+
+            struct pooled_brick_hash
+            {
+                size_t operator()( const pooled_brick& b ) const
+                {
+                    size_t seed = brick_hash {}( b.voxels );
+                    hash_combine( seed, b.palette );
+                    if ( b.has_indices )
+                    {
+                        for ( uint32_t word : b.indices )
+                        {
+                            hash_combine( seed, word );
+                        }
+                    }
+                    return seed;
+                }
+            };
+
+            std::vector<brick> bricks;
+            std::vector<brick_material> materials;
+            std::vector<uint32_t> material_indices;
+            std::unordered_map<pooled_brick, uint32_t, pooled_brick_hash> lookup;
+            uint64_t references {};
+        };
+
+    }
+}
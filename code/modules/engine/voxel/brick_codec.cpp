@@ -0,0 +1,128 @@
+#include "brick_codec.h"
+
+#include <bit>
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+        uint32_t encode_brick( const brick& b, uint32_t* out )
+        {
+            uint32_t header = 0;
+            uint32_t count = 1;
+            for ( int w = 0; w < cell_members; w++ )
+            {
+                const uint32_t word = b.data[w];
+                uint32_t kind;
+                if ( word == 0 )
+                {
+                    kind = brick_word_empty;
+                }
+                else if ( word == 0xFFFFFFFFu )
+                {
+                    kind = brick_word_full;
+                }
+                else if ( w >= 2 && word == b.data[w - 2] )
+                {
+                    kind = brick_word_repeat;
+                }
+                else
+                {
+                    kind = brick_word_literal;
+                    out[count++] = word;
+                }
+                header |= kind << ( w * 2 );
+            }
+            out[0] = header;
+            return count;
+        }
+
+        void decode_brick( const uint32_t* in, brick& out )
+        {
+            const uint32_t header = in[0];
+            const uint32_t* literal = in + 1;
+            for ( int w = 0; w < cell_members; w++ )
+            {
+                switch ( ( header >> ( w * 2 ) ) & 3u )
+                {
+                case brick_word_empty: out.data[w] = 0; break;
+                case brick_word_full: out.data[w] = 0xFFFFFFFFu; break;
+                case brick_word_literal: out.data[w] = *literal++; break;
+                default: out.data[w] = out.data[w - 2]; break;
+                }
+            }
+        }
+
+        uint32_t encoded_brick_words( uint32_t header )
+        {
+            // A word is literal when its high bit is set and its low bit clear.
+            return 1 + std::popcount( header & ~( header << 1 ) & 0xAAAAAAAAu );
+        }
+
+        void packed_bricks::pack( std::span<const brick> bricks )
+        {
+            words.clear();
+            offsets.resize( bricks.size() );
+
+            uint32_t encoded[brick_codec_max_words];
+            for ( size_t i = 0; i < bricks.size(); i++ )
+            {
+                offsets[i] = static_cast<uint32_t>( words.size() );
+                const uint32_t count = encode_brick( bricks[i], encoded );
+                words.insert( words.end(), encoded, encoded + count );
+            }
+            words.shrink_to_fit();
+        }
+
+        std::vector<brick> packed_bricks::unpack_all() const
+        {
+            std::vector<brick> bricks( offsets.size() );
+            for ( uint32_t i = 0; i < offsets.size(); i++ )
+            {
+                unpack( i, bricks[i] );
+            }
+            return bricks;
+        }
+
+        brick_codec_benchmark_result benchmark_brick_codec( std::span<const brick> bricks )
+        {
+            brick_codec_benchmark_result benchmark;
+            benchmark.bricks = static_cast<uint32_t>( bricks.size() );
+            benchmark.raw_bytes = bricks.size_bytes();
+
+            auto time_ms = [&] ( auto&& run )
+            {
+                auto begin = std::chrono::steady_clock::now();
+                run();
+                return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - begin ).count();
+            };
+
+            packed_bricks packed;
+            benchmark.encode_ms = time_ms( [&] () { packed.pack( bricks ); } );
+            benchmark.packed_bytes = packed.size_bytes();
+
+            std::vector<brick> decoded( bricks.size() );
+            benchmark.decode_ms = time_ms( [&] ()
+                {
+                    for ( uint32_t i = 0; i < decoded.size(); i++ )
+                    {
+                        packed.unpack( i, decoded[i] );
+                    }
+                } );
+            benchmark.decoded_bricks_per_second = bricks.size() / std::max( benchmark.decode_ms / 1000.0, 1e-9 );
+
+            benchmark.verified = std::equal( bricks.begin(), bricks.end(), decoded.begin() );
+            if ( !benchmark.verified )
+            {
+                spdlog::error( "Brick codec benchmark: a brick did not decode to what was encoded." );
+            }
+
+            spdlog::info( "Brick codec benchmark, {} bricks: {:.2f} MB to {:.2f} MB ({:.2f}x), encode {:.2f} ms, decode {:.2f} ms, {:.1f} M bricks/s",
+                benchmark.bricks, benchmark.raw_bytes / ( 1024.0 * 1024.0 ), benchmark.packed_bytes / ( 1024.0 * 1024.0 ),
+                benchmark.raw_bytes / double( std::max<uint64_t>( benchmark.packed_bytes, 1 ) ), benchmark.encode_ms, benchmark.decode_ms,
+                benchmark.decoded_bricks_per_second / 1'000'000.0 );
+
+            return benchmark;
+        }
+    }
+}
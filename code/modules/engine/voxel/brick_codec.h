@@ -0,0 +1,66 @@
+#pragma once
+
+#include "brick.h"
+
+#include <span>
+
+// Compressed brick format, one 32 bit header and then the literal words:
+// header: 2 bits per brick word, word w in bits 2w and 2w + 1
+//     0 = every bit clear
+//     1 = every bit set
+//     2 = literal, the next word after the header and the literals of earlier words
+//     3 = same as word w - 2, the same rows one z layer down
+//
+// Terrain bricks are mostly full layers under the surface and empty layers above it, so a surface brick is a header and a few literals.
+// Each word decodes from the header and a popcount of the literals before it, which the placement shader can do per thread as well.
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+        constexpr static uint32_t brick_codec_max_words = 1 + cell_members;
+
+        constexpr static uint32_t brick_word_empty = 0;
+        constexpr static uint32_t brick_word_full = 1;
+        constexpr static uint32_t brick_word_literal = 2;
+        constexpr static uint32_t brick_word_repeat = 3;
+
+        // Writes b to out, at most brick_codec_max_words, and returns the words written.
+        uint32_t encode_brick( const brick& b, uint32_t* out );
+        void decode_brick( const uint32_t* in, brick& out );
+        // Words of an encoded brick, from its header.
+        uint32_t encoded_brick_words( uint32_t header );
+
+        // Bricks encoded back to back.
+        class packed_bricks
+        {
+        public:
+            void pack( std::span<const brick> bricks );
+            void unpack( uint32_t i, brick& out ) const { decode_brick( &words[offsets[i]], out ); }
+            std::vector<brick> unpack_all() const;
+
+            const uint32_t* get_encoded( uint32_t i ) const { return &words[offsets[i]]; }
+            bool empty() const { return offsets.empty(); }
+            uint32_t size() const { return static_cast<uint32_t>( offsets.size() ); }
+            uint64_t size_bytes() const { return ( words.size() + offsets.size() ) * sizeof( uint32_t ); }
+
+        private:
+            std::vector<uint32_t> words;
+            std::vector<uint32_t> offsets;      // First word of each brick.
+        };
+
+        struct brick_codec_benchmark_result
+        {
+            uint32_t bricks {};
+            uint64_t raw_bytes {};
+            uint64_t packed_bytes {};           // Encoded words and the offset of each brick.
+            double encode_ms {};
+            double decode_ms {};
+            double decoded_bricks_per_second {};
+            bool verified {};                   // Every brick decoded to what was encoded.
+        };
+
+        // Encodes and decodes the bricks, checks they round trip and logs the ratio and throughput.
+        brick_codec_benchmark_result benchmark_brick_codec( std::span<const brick> bricks );
+    }
+}
@@ -0,0 +1,109 @@
+#include "brick_heap.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+        uint32_t brick_slot_allocator::allocate( const brick_slot_owner& owner )
+        {
+            uint32_t slot = brick_no_slot;
+            if ( !free_slots.empty() )
+            {
+                slot = free_slots.back();
+                free_slots.pop_back();
+            }
+            else if ( untouched < stats.capacity )
+            {
+                slot = untouched++;
+                owners.emplace_back();
+            }
+            else
+            {
+                stats.failed_allocations++;
+                return brick_no_slot;
+            }
+
+            owners[slot] = owner;
+
+            stats.allocations++;
+            stats.used++;
+            stats.high_water = std::max( stats.high_water, stats.used );
+            return slot;
+        }
+
+        void brick_slot_allocator::free( uint32_t slot )
+        {
+            assert( slot < untouched && owners[slot].chunk_index != brick_no_slot );
+            owners[slot] = {};
+            free_slots.push_back( slot );
+            stats.used--;
+        }
+
+        void brick_slot_allocator::retire( uint32_t slot, uint64_t frame )
+        {
+            assert( slot < untouched && owners[slot].chunk_index != brick_no_slot );
+            assert( retired_slots.empty() || retired_slots.back().frame <= frame );
+            owners[slot] = {};
+            retired_slots.push_back( { frame, slot } );
+            stats.retired++;
+        }
+
+        void brick_slot_allocator::release_retired( uint64_t frame )
+        {
+            while ( !retired_slots.empty() && retired_slots.front().frame <= frame )
+            {
+                free_slots.push_back( retired_slots.front().slot );
+                retired_slots.pop_front();
+                stats.retired--;
+                stats.used--;
+            }
+        }
+
+        void brick_slot_allocator::reset( uint32_t in_capacity )
+        {
+            free_slots.clear();
+            retired_slots.clear();
+            owners.clear();
+            untouched = 0;
+            stats = {};
+            stats.capacity = in_capacity;
+        }
+
+        void brick_slot_allocator::select_least_recently_used( const uint32_t* last_used, uint32_t protect_frame, uint32_t protect_loaded_frame, uint32_t count, std::vector<uint32_t>& victims ) const
+        {
+            struct candidate
+            {
+                uint32_t frame;
+                uint32_t slot;
+            };
+
+            std::vector<candidate> candidates;
+            candidates.reserve( stats.used );
+            for ( uint32_t slot = 0; slot < untouched; slot++ )
+            {
+                const auto& owner = owners[slot];
+                if ( owner.chunk_index == brick_no_slot || owner.loaded_frame >= protect_loaded_frame )
+                {
+                    continue;
+                }
+
+                const uint32_t frame = std::max( last_used[slot], owner.loaded_frame );
+                if ( frame < protect_frame )
+                {
+                    candidates.push_back( { frame, slot } );
+                }
+            }
+
+            // Only the oldest count need to be in order relative to the rest.
+            count = std::min( count, static_cast<uint32_t>( candidates.size() ) );
+            std::nth_element( candidates.begin(), candidates.begin() + count, candidates.end(), [] ( const candidate& a, const candidate& b ) { return a.frame < b.frame; } );
+            for ( uint32_t i = 0; i < count; i++ )
+            {
+                victims.push_back( candidates[i].slot );
+            }
+        }
+    }
+}
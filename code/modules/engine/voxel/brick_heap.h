@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+        constexpr static uint32_t brick_no_slot = 0xFFFFFFFFu;
+
+        struct brick_heap_stats
+        {
+            uint32_t capacity {};           // Slots in the heap.
+            uint32_t used {};               // Including retired slots.
+            uint32_t retired {};            // Freed slots that traces in flight may still read.
+            uint32_t high_water {};         // Most slots ever used at once.
+            uint64_t allocations {};
+            uint64_t failed_allocations {}; // Requests refused because every slot was taken.
+        };
+
+        // The CPU brick a heap slot holds.
+        struct brick_slot_owner
+        {
+            uint32_t chunk_index { brick_no_slot };    // brick_no_slot while the slot is free.
+            uint32_t brick_index {};                    // Into chunk::bricks.
+            uint32_t loaded_frame {};                   // World frame the brick was placed, so a fresh brick counts as used even before it is traced.
+        };
+
+        // Hands out brick slots of the GPU brick heap. Freed slots go on a free list and are reused before the heap grows into untouched slots,
+        // so the heap itself never moves or grows.
+        class brick_slot_allocator
+        {
+        public:
+            brick_slot_allocator() = default;
+            explicit brick_slot_allocator( uint32_t in_capacity ) { reset( in_capacity ); }
+
+            // Returns a free slot, or brick_no_slot when the heap is full.
+            uint32_t allocate( const brick_slot_owner& owner );
+            void free( uint32_t slot );
+            // Frees a slot that traces submitted before frame may still read. It stays used until release_retired passes frame.
+            void retire( uint32_t slot, uint64_t frame );
+            // Frees every slot retired at or before frame.
+            void release_retired( uint64_t frame );
+
+            // Forget every allocation.
+            void reset( uint32_t in_capacity );
+
+            // Appends up to count used slots, least recently used first, to victims.
+            // last_used holds a frame stamp per slot. Slots used at or after protect_frame, or placed at or after protect_loaded_frame, are never chosen.
+            void select_least_recently_used( const uint32_t* last_used, uint32_t protect_frame, uint32_t protect_loaded_frame, uint32_t count, std::vector<uint32_t>& victims ) const;
+
+            const brick_slot_owner& get_owner( uint32_t slot ) const { return owners[slot]; }
+            uint32_t get_capacity() const { return stats.capacity; }
+            uint32_t get_used() const { return stats.used; }
+            // Slots below this have been handed out at least once.
+            uint32_t get_touched() const { return untouched; }
+            const brick_heap_stats& get_stats() const { return stats; }
+
+        private:
+            struct retired_slot
+            {
+                uint64_t frame;
+                uint32_t slot;
+            };
+
+            std::vector<uint32_t> free_slots;
+            std::deque<retired_slot> retired_slots;  // In the order they were retired.
+            std::vector<brick_slot_owner> owners;   // One per slot below untouched.
+            uint32_t untouched {};                  // Slots at or above this have never been handed out.
+            brick_heap_stats stats;
+        };
+    }
+}
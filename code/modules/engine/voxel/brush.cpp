@@ -0,0 +1,85 @@
+#include "brush.h"
+#include "voxelize.h"
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+        voxel_edit make_sphere_brush( const glm::vec3& center, float radius, bool fill, uint8_t material )
+        {
+            voxel_edit edit;
+            edit.min = glm::ivec3( glm::floor( center - radius ) );
+            edit.max = glm::ivec3( glm::floor( center + radius ) );
+            edit.fill = fill;
+            edit.material = material;
+            edit.shape = brush_shape::sphere;
+            edit.center = center;
+            edit.radius = radius;
+            return edit;
+        }
+
+        voxel_edit make_cylinder_brush( const glm::vec3& base_center, float radius, float height, bool fill, uint8_t material )
+        {
+            voxel_edit edit;
+            edit.min = glm::ivec3( glm::floor( base_center - glm::vec3( radius, radius, 0.f ) ) );
+            edit.max = glm::ivec3( glm::floor( base_center + glm::vec3( radius, radius, height ) ) );
+            edit.fill = fill;
+            edit.material = material;
+            edit.shape = brush_shape::cylinder;
+            edit.center = base_center;
+            edit.radius = radius;
+            return edit;
+        }
+
+        bool brush_brick_mask( const voxel_edit& edit, const glm::ivec3& brick_origin, brick& out )
+        {
+            // The brush bounds clipped to the brick, in voxels within the brick.
+            const glm::ivec3 lo = glm::max( edit.min - brick_origin, glm::ivec3( 0 ) );
+            const glm::ivec3 hi = glm::min( edit.max - brick_origin, glm::ivec3( brick_size - 1 ) );
+            if ( glm::any( glm::greaterThan( lo, hi ) ) )
+            {
+                return false;
+            }
+
+            if ( edit.shape == brush_shape::box )
+            {
+                brick_region_mask( lo, hi, out );
+                return true;
+            }
+
+            // Each row along x inside the shape is one run of bits, found from the row's distance to the axis.
+            // A row is a byte of a word, so a brick is 64 runs rather than 512 voxel tests.
+            const float radius_squared = edit.radius * edit.radius;
+            const glm::vec3 center = edit.center - glm::vec3( brick_origin );
+            bool any = false;
+            for ( int z = lo.z; z <= hi.z; z++ )
+            {
+                const float dz = edit.shape == brush_shape::sphere ? z + 0.5f - center.z : 0.f;
+                for ( int y = lo.y; y <= hi.y; y++ )
+                {
+                    const float dy = y + 0.5f - center.y;
+                    const float remaining = radius_squared - dy * dy - dz * dz;
+                    if ( remaining < 0.f )
+                    {
+                        continue;
+                    }
+
+                    // Voxel x is inside when |x + 0.5 - center.x| <= half_width.
+                    const float half_width = std::sqrt( remaining );
+                    const int first = std::max( lo.x, int( std::ceil( center.x - half_width - 0.5f ) ) );
+                    const int last = std::min( hi.x, int( std::floor( center.x + half_width - 0.5f ) ) );
+                    if ( first > last )
+                    {
+                        continue;
+                    }
+
+                    const uint32_t row = ( 0xFFu >> ( brick_size - 1 - ( last - first ) ) ) << first;
+                    const int bit = y * brick_size + z * brick_size * brick_size;
+                    out.data[bit / 32] |= row << ( bit % 32 );
+                    any = true;
+                }
+            }
+            return any;
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "brick.h"
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+        enum class brush_shape : uint8_t
+        {
+            box,
+            sphere,
+            cylinder,       // Upright, along z.
+        };
+
+        // A shape stamped into the world. Fills (union) or clears (subtract) every voxel whose center lies inside it.
+        struct voxel_edit
+        {
+            glm::ivec3 min {};                      // Voxel bounds of the shape, inclusive. A box is exactly its bounds.
+            glm::ivec3 max {};
+            bool fill {};
+            uint8_t material {};                    // Of the voxels a fill sets.
+            brush_shape shape { brush_shape::box };
+            glm::vec3 center {};                    // Sphere center, or the cylinder axis through center.xy. In voxels.
+            float radius {};
+        };
+
+        // The voxel bounds of a sphere or a cylinder standing on base_center.
+        voxel_edit make_sphere_brush( const glm::vec3& center, float radius, bool fill, uint8_t material );
+        voxel_edit make_cylinder_brush( const glm::vec3& base_center, float radius, float height, bool fill, uint8_t material );
+
+        // Sets the bits of the voxels of the brick at brick_origin that the brush covers, one word at a time.
+        // Returns false when it covers none of them.
+        bool brush_brick_mask( const voxel_edit& edit, const glm::ivec3& brick_origin, brick& out );
+    }
+}
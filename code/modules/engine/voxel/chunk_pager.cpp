@@ -0,0 +1,188 @@
+#include "chunk_pager.h"
+#include "world.h"
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+        std::unique_ptr<chunk_pager> chunk_pager::create( const std::string& path, std::vector<world_file_chunk> table, uint64_t memory_budget )
+        {
+            auto pager = std::make_unique<chunk_pager>( path, std::move( table ), memory_budget );
+            if ( !pager->is_open() )
+            {
+                spdlog::error( "Chunk pager unable to open world file {}.", path );
+                return nullptr;
+            }
+            return pager;
+        }
+
+        chunk_pager::chunk_pager( const std::string& in_path, std::vector<world_file_chunk> in_table, uint64_t in_memory_budget )
+            : path( in_path ), file( in_path, std::ios::binary ), table( std::move( in_table ) ), memory_budget( in_memory_budget )
+        {
+            if ( !file )
+            {
+                return;
+            }
+
+            pages.resize( table.size() );
+
+            // Chunks without bricks never need to be read.
+            for ( int i = 0; i < table.size(); i++ )
+            {
+                if ( table[i].brick_count == 0 )
+                {
+                    pages[i].state = page_state::resident;
+                }
+            }
+
+            worker = std::thread( [this] () { worker_loop(); } );
+        }
+
+        chunk_pager::~chunk_pager()
+        {
+            {
+                std::lock_guard lock( mutex );
+                quit = true;
+            }
+            wake.notify_all();
+            if ( worker.joinable() )
+            {
+                worker.join();
+            }
+        }
+
+        bool chunk_pager::acquire( uint32_t chunk_index )
+        {
+            touch( chunk_index );
+
+            if ( pages[chunk_index].state == page_state::resident )
+            {
+                stats.hits++;
+                return true;
+            }
+
+            stats.misses++;
+            return false;
+        }
+
+        void chunk_pager::touch( uint32_t chunk_index )
+        {
+            auto& page = pages[chunk_index];
+            page.last_used = frame;
+
+            if ( page.state == page_state::evicted )
+            {
+                page.state = page_state::pending;
+                {
+                    std::lock_guard lock( mutex );
+                    requested.push_back( chunk_index );
+                }
+                wake.notify_one();
+            }
+        }
+
+        void chunk_pager::update( std::vector<std::unique_ptr<chunk>>& chunks )
+        {
+            ZoneScopedN( "chunk pager - update" );
+
+            std::vector<page_in> finished;
+            {
+                std::lock_guard lock( mutex );
+                finished.swap( completed );
+            }
+
+            for ( auto& result : finished )
+            {
+                if ( result.failed )
+                {
+                    // Evicted again, so the next use of the chunk asks for it once more.
+                    pages[result.chunk_index].state = page_state::evicted;
+                    stats.failed_reads++;
+                    continue;
+                }
+
+                auto& chunk = chunks[result.chunk_index];
+                chunk->brick_storage = std::move( result.bricks );
+                chunk->bricks = chunk->brick_storage;
+
+                pages[result.chunk_index].state = page_state::resident;
+                stats.resident_bytes += chunk->bricks.size_bytes();
+                stats.resident_chunks++;
+                stats.page_ins++;
+            }
+
+            if ( stats.resident_bytes > memory_budget )
+            {
+                // Evict the least recently used chunks. Anything touched this frame stays, even if that exceeds the budget.
+                std::vector<uint32_t> candidates;
+                for ( uint32_t i = 0; i < pages.size(); i++ )
+                {
+                    if ( pages[i].state == page_state::resident && !pages[i].pinned && table[i].brick_count > 0 && pages[i].last_used < frame )
+                    {
+                        candidates.push_back( i );
+                    }
+                }
+
+                std::sort( candidates.begin(), candidates.end(), [this] ( uint32_t a, uint32_t b ) { return pages[a].last_used < pages[b].last_used; } );
+
+                for ( uint32_t chunk_index : candidates )
+                {
+                    if ( stats.resident_bytes <= memory_budget )
+                    {
+                        break;
+                    }
+
+                    auto& chunk = chunks[chunk_index];
+                    stats.resident_bytes -= chunk->bricks.size_bytes();
+                    stats.resident_chunks--;
+                    stats.evictions++;
+
+                    chunk->bricks = {};
+                    chunk->brick_storage = {};
+                    pages[chunk_index].state = page_state::evicted;
+                }
+            }
+
+            frame++;
+        }
+
+        void chunk_pager::worker_loop()
+        {
+            while ( true )
+            {
+                uint32_t chunk_index {};
+                {
+                    std::unique_lock lock( mutex );
+                    wake.wait( lock, [this] () { return quit || !requested.empty(); } );
+                    if ( quit )
+                    {
+                        return;
+                    }
+
+                    chunk_index = requested.front();
+                    requested.pop_front();
+                }
+
+                const auto& entry = table[chunk_index];
+
+                page_in result;
+                result.chunk_index = chunk_index;
+                result.bricks.resize( entry.brick_count );
+
+                file.seekg( entry.brick_offset );
+                file.read( reinterpret_cast<char*>( result.bricks.data() ), entry.brick_count * sizeof( brick ) );
+                if ( !file )
+                {
+                    // Keep serving the other chunks. This one is handed back as failed and retried when it is used again.
+                    spdlog::error( "Chunk pager failed reading chunk {} from {}.", chunk_index, path );
+                    file.clear();
+                    result.bricks = {};
+                    result.failed = true;
+                }
+
+                std::lock_guard lock( mutex );
+                completed.push_back( std::move( result ) );
+            }
+        }
+    }
+}
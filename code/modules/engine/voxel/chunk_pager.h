@@ -0,0 +1,99 @@
+#pragma once
+
+#include "world_file.h"
+
+#include <condition_variable>
+#include <fstream>
+#include <thread>
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+        struct brick;
+        struct chunk;
+
+        struct chunk_pager_stats
+        {
+            uint64_t hits {};               // Brick requests served from a resident chunk.
+            uint64_t misses {};             // Brick requests that had to wait for a chunk to be paged in.
+            uint64_t page_ins {};
+            uint64_t evictions {};
+            uint64_t failed_reads {};       // Page-ins that could not be read. The chunk is evicted again and retried when next used.
+            uint64_t resident_bytes {};
+            uint32_t resident_chunks {};
+        };
+
+        // Keeps the CPU bricks of a subset of chunks resident, reading the rest from a world file on a background thread.
+        // Chunk indices are always resident; only chunk::bricks is paged.
+        // All methods except the constructor and destructor must be called from the thread that owns the chunks.
+        class chunk_pager
+        {
+        public:
+            // Returns null when the world file cannot be opened.
+            static std::unique_ptr<chunk_pager> create( const std::string& path, std::vector<world_file_chunk> table, uint64_t memory_budget );
+
+            ~chunk_pager();
+            chunk_pager() = delete;
+            chunk_pager( const std::string& path, std::vector<world_file_chunk> table, uint64_t memory_budget );
+
+            bool is_open() const { return file.is_open(); }
+
+            // Marks a chunk as used by the GPU this frame. Returns true if its bricks are resident, otherwise queues a page-in.
+            bool acquire( uint32_t chunk_index );
+
+            // Marks a chunk as used this frame without counting a hit or miss. Used to keep chunks around the camera resident.
+            void touch( uint32_t chunk_index );
+
+            // Never evicts a resident chunk again, once its bricks have been edited and differ from the file.
+            void pin( uint32_t chunk_index ) { pages[chunk_index].pinned = true; }
+
+            // Installs finished page-ins and evicts the least recently used chunks until the memory budget is met.
+            void update( std::vector<std::unique_ptr<chunk>>& chunks );
+
+            void set_memory_budget( uint64_t bytes ) { memory_budget = bytes; }
+            uint64_t get_memory_budget() const { return memory_budget; }
+            const chunk_pager_stats& get_stats() const { return stats; }
+
+        private:
+            enum class page_state : uint8_t
+            {
+                evicted,
+                pending,
+                resident
+            };
+
+            struct page_entry
+            {
+                page_state state { page_state::evicted };
+                uint64_t last_used {};
+                bool pinned {};
+            };
+
+            struct page_in
+            {
+                uint32_t chunk_index {};
+                std::vector<brick> bricks;
+                bool failed {};
+            };
+
+            void worker_loop();
+
+            std::string path;
+            std::ifstream file;                     // Only read by the worker thread once it is started.
+            std::vector<world_file_chunk> table;
+            std::vector<page_entry> pages;
+            uint64_t memory_budget {};
+            uint64_t frame { 1 };
+            chunk_pager_stats stats;
+
+            // Shared with the worker thread.
+            std::mutex mutex;
+            std::condition_variable wake;
+            std::deque<uint32_t> requested;
+            std::vector<page_in> completed;
+            bool quit {};
+            std::thread worker;
+        };
+    }
+}
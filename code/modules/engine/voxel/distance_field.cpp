@@ -0,0 +1,331 @@
+#include "distance_field.h"
+#include "jobs/job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+        void cell_distance_field::build( int cells_x, int cells_y, int cells_z, const occupied_fn& occupied )
+        {
+            auto begin = std::chrono::steady_clock::now();
+
+            size_x = cells_x;
+            size_y = cells_y;
+            size_z = cells_z;
+            distances.assign( size_t( size_x ) * size_y * size_z, 0 );
+
+            const int lo[3] = { 0, 0, 0 };
+            const int hi[3] = { size_x, size_y, size_z };
+            compute( lo, hi, occupied, nullptr );
+
+            uint64_t empty_cells = 0;
+            uint64_t distance_sum = 0;
+            for ( uint8_t distance : distances )
+            {
+                empty_cells += distance > 0;
+                distance_sum += distance;
+            }
+
+            stats.cells = distances.size();
+            stats.memory_bytes = distances.size() * sizeof( uint8_t );
+            stats.build_ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - begin ).count();
+            stats.average_distance = distance_sum / double( std::max<uint64_t>( empty_cells, 1 ) );
+        }
+
+        uint64_t cell_distance_field::update( int min_x, int min_y, int min_z, int max_x, int max_y, int max_z, const occupied_fn& occupied, std::vector<uint32_t>& changed )
+        {
+            // Only cells within cell_distance_max of a changed cell can see it.
+            const int lo[3] = { std::max( min_x - cell_distance_max, 0 ), std::max( min_y - cell_distance_max, 0 ), std::max( min_z - cell_distance_max, 0 ) };
+            const int hi[3] = { std::min( max_x + 1 + cell_distance_max, size_x ), std::min( max_y + 1 + cell_distance_max, size_y ), std::min( max_z + 1 + cell_distance_max, size_z ) };
+            compute( lo, hi, occupied, &changed );
+            return uint64_t( hi[0] - lo[0] ) * ( hi[1] - lo[1] ) * ( hi[2] - lo[2] );
+        }
+
+        void cell_distance_field::compute( const int lo[3], const int hi[3], const occupied_fn& occupied, std::vector<uint32_t>* changed )
+        {
+            constexpr int k = cell_distance_max;
+            auto* job_sys = jobs::job_system_locator::get();
+
+            // The x pass covers every cell the y pass looks at, and the y pass every cell the z pass looks at.
+            const int lo_x[3] = { lo[0], std::max( lo[1] - k, 0 ), std::max( lo[2] - k, 0 ) };
+            const int hi_x[3] = { hi[0], std::min( hi[1] + k, size_y ), std::min( hi[2] + k, size_z ) };
+            const int lo_y[3] = { lo[0], lo[1], lo_x[2] };
+            const int hi_y[3] = { hi[0], hi[1], hi_x[2] };
+
+            const int width = hi[0] - lo[0];
+            const int rows_x = hi_x[1] - lo_x[1];
+            const int rows_y = hi_y[1] - lo_y[1];
+            auto index_x = [&] ( int x, int y, int z ) { return size_t( x - lo[0] ) + size_t( y - lo_x[1] ) * width + size_t( z - lo_x[2] ) * width * rows_x; };
+            auto index_y = [&] ( int x, int y, int z ) { return size_t( x - lo[0] ) + size_t( y - lo_y[1] ) * width + size_t( z - lo_y[2] ) * width * rows_y; };
+
+            std::vector<uint8_t> along_x( size_t( width ) * rows_x * ( hi_x[2] - lo_x[2] ) );
+            std::vector<uint8_t> along_y( size_t( width ) * rows_y * ( hi_y[2] - lo_y[2] ) );
+
+            // Along x the distance is exact from a sweep each way over the row, starting k cells out.
+            const int first_x = std::max( lo[0] - k, 0 );
+            const int last_x = std::min( hi[0] + k, size_x );
+            job_sys->parallel_for( rows_x * ( hi_x[2] - lo_x[2] ), 16, [&] ( uint32_t begin, uint32_t end )
+                {
+                    std::vector<uint8_t> row( last_x - first_x );
+                    for ( uint32_t r = begin; r < end; r++ )
+                    {
+                        const int y = lo_x[1] + int( r ) % rows_x;
+                        const int z = lo_x[2] + int( r ) / rows_x;
+                        for ( int x = first_x; x < last_x; x++ )
+                        {
+                            row[x - first_x] = occupied( x, y, z );
+                        }
+
+                        int since = k;
+                        for ( int x = first_x; x < last_x; x++ )
+                        {
+                            since = row[x - first_x] ? 0 : std::min( since + 1, k );
+                            if ( x >= lo[0] && x < hi[0] )
+                            {
+                                along_x[index_x( x, y, z )] = uint8_t( since );
+                            }
+                        }
+                        since = k;
+                        for ( int x = last_x - 1; x >= first_x; x-- )
+                        {
+                            since = row[x - first_x] ? 0 : std::min( since + 1, k );
+                            if ( x >= lo[0] && x < hi[0] )
+                            {
+                                uint8_t& distance = along_x[index_x( x, y, z )];
+                                distance = std::min( distance, uint8_t( since ) );
+                            }
+                        }
+                    }
+                } );
+
+            // Along y and z a cell r away can do no better than r, so the search stops once r reaches the best so far.
+            job_sys->parallel_for( rows_y * ( hi_y[2] - lo_y[2] ), 16, [&] ( uint32_t begin, uint32_t end )
+                {
+                    for ( uint32_t r = begin; r < end; r++ )
+                    {
+                        const int y = lo_y[1] + int( r ) % rows_y;
+                        const int z = lo_y[2] + int( r ) / rows_y;
+                        for ( int x = lo[0]; x < hi[0]; x++ )
+                        {
+                            int best = along_x[index_x( x, y, z )];
+                            for ( int d = 1; d < best; d++ )
+                            {
+                                if ( y - d >= lo_x[1] )
+                                {
+                                    best = std::min( best, std::max<int>( d, along_x[index_x( x, y - d, z )] ) );
+                                }
+                                if ( y + d < hi_x[1] )
+                                {
+                                    best = std::min( best, std::max<int>( d, along_x[index_x( x, y + d, z )] ) );
+                                }
+                            }
+                            along_y[index_y( x, y, z )] = uint8_t( best );
+                        }
+                    }
+                } );
+
+            // Updates write to their own buffer first so the changed cells can be found without locking.
+            const int rows = hi[1] - lo[1];
+            std::vector<uint8_t> updated( changed ? size_t( width ) * rows * ( hi[2] - lo[2] ) : 0 );
+            job_sys->parallel_for( rows * ( hi[2] - lo[2] ), 16, [&] ( uint32_t begin, uint32_t end )
+                {
+                    for ( uint32_t r = begin; r < end; r++ )
+                    {
+                        const int y = lo[1] + int( r ) % rows;
+                        const int z = lo[2] + int( r ) / rows;
+                        for ( int x = lo[0]; x < hi[0]; x++ )
+                        {
+                            int best = along_y[index_y( x, y, z )];
+                            for ( int d = 1; d < best; d++ )
+                            {
+                                if ( z - d >= lo_y[2] )
+                                {
+                                    best = std::min( best, std::max<int>( d, along_y[index_y( x, y, z - d )] ) );
+                                }
+                                if ( z + d < hi_y[2] )
+                                {
+                                    best = std::min( best, std::max<int>( d, along_y[index_y( x, y, z + d )] ) );
+                                }
+                            }
+
+                            if ( changed )
+                            {
+                                updated[size_t( r ) * width + ( x - lo[0] )] = uint8_t( best );
+                            }
+                            else
+                            {
+                                distances[get_cell( x, y, z )] = uint8_t( best );
+                            }
+                        }
+                    }
+                } );
+
+            if ( changed )
+            {
+                for ( int z = lo[2]; z < hi[2]; z++ )
+                {
+                    for ( int y = lo[1]; y < hi[1]; y++ )
+                    {
+                        const uint8_t* row = &updated[( size_t( z - lo[2] ) * rows + ( y - lo[1] ) ) * width];
+                        for ( int x = lo[0]; x < hi[0]; x++ )
+                        {
+                            const uint32_t cell = get_cell( x, y, z );
+                            if ( distances[cell] != row[x - lo[0]] )
+                            {
+                                distances[cell] = row[x - lo[0]];
+                                changed->push_back( cell );
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        cell_distance_benchmark_result benchmark_cell_distance_field()
+        {
+            struct grid_shape
+            {
+                int x, y, z;
+                int density;                    // One cell in density is occupied.
+            };
+            // Odd sizes so the passes meet the grid edges at every offset, sparse enough that many cells reach cell_distance_max.
+            const grid_shape shapes[] = { { 37, 29, 33, 20 }, { 45, 21, 38, 300 }, { 29, 40, 27, 3000 } };
+            constexpr int edits_per_grid = 8;
+
+            std::mt19937 rng( 1234 );
+            cell_distance_benchmark_result benchmark;
+            benchmark.verified = true;
+
+            auto time_ms = [&] ( auto&& run )
+            {
+                auto begin = std::chrono::steady_clock::now();
+                run();
+                return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - begin ).count();
+            };
+
+            for ( const grid_shape& shape : shapes )
+            {
+                auto cell_of = [&] ( int x, int y, int z ) { return size_t( x ) + size_t( y ) * shape.x + size_t( z ) * shape.x * shape.y; };
+
+                std::vector<uint8_t> grid( size_t( shape.x ) * shape.y * shape.z );
+                std::uniform_int_distribution<int> pick( 0, shape.density - 1 );
+                for ( auto& cell : grid )
+                {
+                    cell = pick( rng ) == 0;
+                }
+                auto occupied = [&] ( int x, int y, int z ) { return grid[cell_of( x, y, z )] != 0; };
+
+                // The nearest occupied cell of each, searched over all of them. Cells outside the grid count as empty, as they do for the field.
+                std::vector<uint8_t> expected( grid.size() );
+                auto brute_force = [&] ()
+                {
+                    std::vector<glm::ivec3> occupied_cells;
+                    for ( int z = 0; z < shape.z; z++ )
+                    {
+                        for ( int y = 0; y < shape.y; y++ )
+                        {
+                            for ( int x = 0; x < shape.x; x++ )
+                            {
+                                if ( occupied( x, y, z ) )
+                                {
+                                    occupied_cells.push_back( { x, y, z } );
+                                }
+                            }
+                        }
+                    }
+
+                    for ( int z = 0; z < shape.z; z++ )
+                    {
+                        for ( int y = 0; y < shape.y; y++ )
+                        {
+                            for ( int x = 0; x < shape.x; x++ )
+                            {
+                                int best = cell_distance_max;
+                                for ( const glm::ivec3& other : occupied_cells )
+                                {
+                                    best = std::min( best, std::max( { std::abs( other.x - x ), std::abs( other.y - y ), std::abs( other.z - z ) } ) );
+                                }
+                                expected[cell_of( x, y, z )] = uint8_t( best );
+                            }
+                        }
+                    }
+                };
+
+                auto verify = [&] ( const cell_distance_field& field, const char* name )
+                {
+                    for ( size_t cell = 0; cell < grid.size() && benchmark.verified; cell++ )
+                    {
+                        if ( field.at( uint32_t( cell ) ) != expected[cell] )
+                        {
+                            spdlog::error( "Cell distance benchmark: {} gives {} at cell {} of a {}x{}x{} grid, brute force gives {}.", name, field.at( uint32_t( cell ) ), cell, shape.x, shape.y, shape.z, expected[cell] );
+                            benchmark.verified = false;
+                        }
+                    }
+                };
+
+                cell_distance_field field;
+                benchmark.build_ms += time_ms( [&] () { field.build( shape.x, shape.y, shape.z, occupied ); } );
+                benchmark.brute_force_ms += time_ms( brute_force );
+                benchmark.cells += grid.size();
+                verify( field, "build" );
+
+                // Each edit fills or clears a random box, some of them touching the grid edges.
+                for ( int edit = 0; edit < edits_per_grid && benchmark.verified; edit++ )
+                {
+                    const int extent = std::uniform_int_distribution<int>( 0, 8 )( rng );
+                    const glm::ivec3 size( shape.x, shape.y, shape.z );
+                    glm::ivec3 lo;
+                    for ( int axis = 0; axis < 3; axis++ )
+                    {
+                        lo[axis] = std::uniform_int_distribution<int>( -extent / 2, size[axis] - 1 )( rng );
+                    }
+                    const glm::ivec3 hi = glm::min( lo + extent, size - 1 );
+                    lo = glm::max( lo, glm::ivec3( 0 ) );
+
+                    const uint8_t fill = edit % 2 == 0;
+                    for ( int z = lo.z; z <= hi.z; z++ )
+                    {
+                        for ( int y = lo.y; y <= hi.y; y++ )
+                        {
+                            for ( int x = lo.x; x <= hi.x; x++ )
+                            {
+                                grid[cell_of( x, y, z )] = fill;
+                            }
+                        }
+                    }
+
+                    const std::vector<uint8_t> before = expected;
+                    std::vector<uint32_t> changed;
+                    benchmark.updated_cells += field.update( lo.x, lo.y, lo.z, hi.x, hi.y, hi.z, occupied, changed );
+                    benchmark.updates++;
+                    brute_force();
+                    verify( field, "update" );
+
+                    // The changed list is what the world patches on the GPU, so it has to name every changed cell and nothing else.
+                    uint64_t expected_changes = 0;
+                    for ( size_t cell = 0; cell < grid.size(); cell++ )
+                    {
+                        expected_changes += before[cell] != expected[cell];
+                    }
+                    std::sort( changed.begin(), changed.end() );
+                    const bool unique = std::adjacent_find( changed.begin(), changed.end() ) == changed.end();
+                    const bool all_changed = std::all_of( changed.begin(), changed.end(), [&] ( uint32_t cell ) { return before[cell] != expected[cell]; } );
+                    if ( benchmark.verified && ( !unique || !all_changed || changed.size() != expected_changes ) )
+                    {
+                        spdlog::error( "Cell distance benchmark: an update reported {} changed cells, brute force finds {}.", changed.size(), expected_changes );
+                        benchmark.verified = false;
+                    }
+                }
+            }
+
+            spdlog::info( "Cell distance benchmark, {} cells: build {:.2f} ms, brute force {:.2f} ms, {} updates recomputing {} cells{}",
+                benchmark.cells, benchmark.build_ms, benchmark.brute_force_ms, benchmark.updates, benchmark.updated_cells, benchmark.verified ? "" : " (MISMATCH)" );
+
+            return benchmark;
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+        // Distances stop growing here. A cell at cell_distance_max is at least that far from anything.
+        constexpr static int cell_distance_max = 15;
+
+        struct cell_distance_stats
+        {
+            uint64_t cells {};
+            uint64_t memory_bytes {};           // On the host. The GPU keeps each distance in spare bits of the cell index.
+            double build_ms {};
+            double average_distance {};         // Over the empty cells.
+        };
+
+        // Chebyshev distance from every cell of the world grid to the nearest cell that is not empty, in cells, capped at cell_distance_max.
+        // A cell d away has no occupied cell within d - 1 of it along any axis, so a ray may leave that box of cells in one step.
+        // Computed with one pass per axis, each of which only looks cell_distance_max cells along it.
+        class cell_distance_field
+        {
+        public:
+            // Whether the cell at x, y, z, in cells, has a brick or is solid. Called from many threads at once.
+            using occupied_fn = std::function<bool( int x, int y, int z )>;
+
+            void build( int cells_x, int cells_y, int cells_z, const occupied_fn& occupied );
+
+            // Recomputes every cell whose distance may have changed after the cells in [min, max] did, and appends the ones that changed to changed.
+            // Returns the cells recomputed. The stats are those of the latest build.
+            uint64_t update( int min_x, int min_y, int min_z, int max_x, int max_y, int max_z, const occupied_fn& occupied, std::vector<uint32_t>& changed );
+
+            uint8_t at( int x, int y, int z ) const { return distances[get_cell( x, y, z )]; }
+            uint8_t at( uint32_t cell ) const { return distances[cell]; }
+            uint32_t get_cell( int x, int y, int z ) const { return uint32_t( x ) + uint32_t( y ) * size_x + uint32_t( z ) * size_x * size_y; }
+            bool empty() const { return distances.empty(); }
+
+            const cell_distance_stats& get_stats() const { return stats; }
+
+        private:
+            // Computes the cells in [lo, hi) into distances, recording the changed ones when changed is given.
+            void compute( const int lo[3], const int hi[3], const occupied_fn& occupied, std::vector<uint32_t>* changed );
+
+            int size_x {};
+            int size_y {};
+            int size_z {};
+            std::vector<uint8_t> distances;     // x + y * size_x + z * size_x * size_y
+            cell_distance_stats stats;
+        };
+
+        struct cell_distance_benchmark_result
+        {
+            uint64_t cells {};                  // Over every grid.
+            double build_ms {};
+            double brute_force_ms {};
+            uint32_t updates {};
+            uint64_t updated_cells {};          // Recomputed by the updates.
+            bool verified {};                   // Every build and update matched a brute force search, and reported exactly the cells that changed.
+        };
+
+        // Builds fields over random grids, then updates them after random edits, checking every distance against a brute force search and logging the timings.
+        cell_distance_benchmark_result benchmark_cell_distance_field();
+    }
+}
@@ -0,0 +1,72 @@
+#include "heightmap_cache.h"
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+        std::unique_ptr<heightmap_cache> heightmap_cache::create( int tile_size, generator generate_tile )
+        {
+            return std::make_unique<heightmap_cache>( tile_size, std::move( generate_tile ) );
+        }
+
+        heightmap_cache::heightmap_cache( int in_tile_size, generator in_generate_tile )
+            : tile_size( in_tile_size ), generate_tile( std::move( in_generate_tile ) )
+        {
+        }
+
+        std::shared_ptr<const heightmap_tile> heightmap_cache::get( int tile_x, int tile_y )
+        {
+            std::shared_ptr<entry> found;
+            {
+                std::lock_guard lock( mutex );
+                stats.lookups++;
+
+                auto& slot = tiles[key( tile_x, tile_y )];
+                if ( !slot )
+                {
+                    slot = std::make_shared<entry>();
+                }
+                found = slot;
+            }
+
+            // Evaluate outside the lock so other tiles can be generated in parallel.
+            std::call_once( found->generated, [&] ()
+                {
+                    auto tile = std::make_shared<heightmap_tile>();
+                    tile->size = tile_size;
+                    tile->heights.resize( size_t( tile_size ) * tile_size );
+                    generate_tile( tile_x, tile_y, *tile );
+                    found->tile = std::move( tile );
+
+                    std::lock_guard lock( mutex );
+                    stats.generated++;
+                } );
+
+            return found->tile;
+        }
+
+        void heightmap_cache::invalidate( int tile_x, int tile_y )
+        {
+            std::lock_guard lock( mutex );
+            tiles.erase( key( tile_x, tile_y ) );
+        }
+
+        void heightmap_cache::clear()
+        {
+            std::lock_guard lock( mutex );
+            tiles.clear();
+        }
+
+        heightmap_cache_stats heightmap_cache::get_stats() const
+        {
+            std::lock_guard lock( mutex );
+            return stats;
+        }
+
+        uint64_t heightmap_cache::get_memory_usage() const
+        {
+            std::lock_guard lock( mutex );
+            return tiles.size() * uint64_t( tile_size ) * tile_size * sizeof( uint16_t );
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+        // The terrain heights of one chunk column, shared by every chunk stacked in that column.
+        // Heights are rounded up: a voxel at integer z is set when z < height.
+        struct heightmap_tile
+        {
+            int size {};                    // Voxels per side.
+            std::vector<uint16_t> heights;  // x + y * size
+
+            int at( int x, int y ) const { return heights[x + y * size]; }
+        };
+
+        struct heightmap_cache_stats
+        {
+            uint64_t lookups {};
+            uint64_t generated {};          // Tiles evaluated, the rest of the lookups reused a tile.
+        };
+
+        // Evaluates each heightmap tile once, on first use, and keeps it for regenerating or editing the region later.
+        // get() is safe to call from many threads; concurrent callers of the same tile wait for a single evaluation.
+        class heightmap_cache
+        {
+        public:
+            using generator = std::function<void( int tile_x, int tile_y, heightmap_tile& tile )>;
+
+            static std::unique_ptr<heightmap_cache> create( int tile_size, generator generate_tile );
+
+            heightmap_cache() = delete;
+            heightmap_cache( int tile_size, generator generate_tile );
+
+            std::shared_ptr<const heightmap_tile> get( int tile_x, int tile_y );
+
+            // Drop a tile so the next get() evaluates it again, e.g. after changing the terrain parameters of a region.
+            void invalidate( int tile_x, int tile_y );
+            void clear();
+
+            heightmap_cache_stats get_stats() const;
+            uint64_t get_memory_usage() const;
+
+        private:
+            struct entry
+            {
+                std::once_flag generated;
+                std::shared_ptr<heightmap_tile> tile;
+            };
+
+            static uint64_t key( int tile_x, int tile_y ) { return ( uint64_t( uint32_t( tile_y ) ) << 32 ) | uint32_t( tile_x ); }
+
+            int tile_size {};
+            generator generate_tile;
+
+            mutable std::mutex mutex;
+            std::unordered_map<uint64_t, std::shared_ptr<entry>> tiles;
+            heightmap_cache_stats stats;
+        };
+    }
+}
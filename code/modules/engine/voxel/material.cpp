@@ -0,0 +1,133 @@
+#include "material.h"
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+        namespace
+        {
+            uint32_t color_distance( uint32_t a, uint32_t b )
+            {
+                uint32_t distance = 0;
+                for ( int channel = 0; channel < 3; channel++ )
+                {
+                    const int delta = int( ( a >> ( channel * 8 ) ) & 0xFFu ) - int( ( b >> ( channel * 8 ) ) & 0xFFu );
+                    distance += delta * delta;
+                }
+                return distance;
+            }
+        }
+
+        material_colors make_gray_colors()
+        {
+            material_colors colors;
+            for ( uint32_t i = 0; i < material_count; i++ )
+            {
+                colors[i] = 0xFF000000u | i << 16 | i << 8 | i;
+            }
+            return colors;
+        }
+
+        material_colors make_terrain_colors()
+        {
+            material_colors colors = make_gray_colors();
+            colors[terrain_material_peak] = 0xFFFFFFFFu;
+            colors[terrain_material_rock] = 0xFF999999u;
+            colors[terrain_material_grass] = 0xFF80FF80u;
+            colors[terrain_material_lowland] = 0xFFFF8080u;
+            return colors;
+        }
+
+        uint8_t terrain_material( int z, int grid_height )
+        {
+            const float height = z + 0.5f;
+            if ( height > grid_height * 0.8f )
+            {
+                return terrain_material_peak;
+            }
+            if ( height > grid_height * 0.4f )
+            {
+                return terrain_material_rock;
+            }
+            if ( height > grid_height * 0.2f )
+            {
+                return terrain_material_grass;
+            }
+            return terrain_material_lowland;
+        }
+
+        bool pack_brick_materials( const brick& b, const uint8_t* voxel_materials, const material_colors& colors, uint32_t& palette, uint32_t* indices )
+        {
+            constexpr int voxels = brick_size * brick_size * brick_size;
+
+            uint32_t counts[material_count] {};
+            for ( int v = 0; v < voxels; v++ )
+            {
+                if ( b.data[v / 32] & ( 1u << ( v % 32 ) ) )
+                {
+                    counts[voxel_materials[v]]++;
+                }
+            }
+
+            // The most common materials make the palette, taking their counts out so only the materials left over remain.
+            uint8_t entry_of[material_count] {};
+            int entries = 0;
+            palette = 0;
+            for ( ; entries < brick_palette_size; entries++ )
+            {
+                uint32_t* most = std::max_element( std::begin( counts ), std::end( counts ) );
+                if ( *most == 0 )
+                {
+                    break;
+                }
+                *most = 0;
+                const uint32_t material = static_cast<uint32_t>( most - std::begin( counts ) );
+                entry_of[material] = static_cast<uint8_t>( entries );
+                palette |= material << ( entries * 8 );
+            }
+
+            if ( entries <= 1 )
+            {
+                return false;
+            }
+
+            for ( uint32_t material = 0; material < material_count; material++ )
+            {
+                if ( counts[material] == 0 )
+                {
+                    continue;
+                }
+                uint32_t nearest = UINT32_MAX;
+                for ( int entry = 0; entry < entries; entry++ )
+                {
+                    const uint32_t distance = color_distance( colors[material], colors[get_palette_material( palette, entry )] );
+                    if ( distance < nearest )
+                    {
+                        nearest = distance;
+                        entry_of[material] = static_cast<uint8_t>( entry );
+                    }
+                }
+            }
+
+            std::fill( indices, indices + material_index_words, 0u );
+            for ( int v = 0; v < voxels; v++ )
+            {
+                if ( b.data[v / 32] & ( 1u << ( v % 32 ) ) )
+                {
+                    indices[v / 16] |= uint32_t( entry_of[voxel_materials[v]] ) << ( ( v % 16 ) * 2 );
+                }
+            }
+            return true;
+        }
+
+        void unpack_brick_materials( uint32_t palette, const uint32_t* indices, uint8_t* voxel_materials )
+        {
+            constexpr int voxels = brick_size * brick_size * brick_size;
+            for ( int v = 0; v < voxels; v++ )
+            {
+                const uint32_t entry = indices ? ( indices[v / 16] >> ( ( v % 16 ) * 2 ) ) & 3u : 0;
+                voxel_materials[v] = get_palette_material( palette, entry );
+            }
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "brick.h"
+
+#include <array>
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+        // Material ids are a byte.
+        constexpr static int material_count = 256;
+
+        // The color of each material id, RGBA8 with red in the low byte. Only the shade kernel reads them, for the voxels rays hit.
+        using material_colors = std::array<uint32_t, material_count>;
+
+        // Materials of the generated terrain, in bands from the top of the world down.
+        constexpr static uint8_t terrain_material_peak = 0;
+        constexpr static uint8_t terrain_material_rock = 1;
+        constexpr static uint8_t terrain_material_grass = 2;
+        constexpr static uint8_t terrain_material_lowland = 3;
+
+        // Material i is a gray of brightness i. Raw volumes use their voxel bytes as material ids.
+        material_colors make_gray_colors();
+        // The terrain bands, and the gray ramp for the ids they leave.
+        material_colors make_terrain_colors();
+
+        // The band of the voxels at height z in a world grid_height voxels tall.
+        uint8_t terrain_material( int z, int grid_height );
+
+        // Reduces a brick's material ids, one per voxel numbered as the bits of brick::data, to a palette and a 2 bit palette entry per voxel.
+        // Only set voxels count. A brick with more than brick_palette_size materials keeps the most common ones and the others take the nearest color among those.
+        // Returns false when every set voxel has the same material, leaving indices as they are, since the palette alone describes the brick then.
+        bool pack_brick_materials( const brick& b, const uint8_t* voxel_materials, const material_colors& colors, uint32_t& palette, uint32_t* indices );
+
+        // The material id of every voxel. indices is null for a brick whose voxels are all palette entry 0.
+        void unpack_brick_materials( uint32_t palette, const uint32_t* indices, uint8_t* voxel_materials );
+
+        inline uint8_t get_palette_material( uint32_t palette, uint32_t entry ) { return static_cast<uint8_t>( palette >> ( entry * 8 ) ); }
+    }
+}
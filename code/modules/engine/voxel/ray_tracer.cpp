@@ -157,12 +157,8 @@ namespace rebel_road
 
         void ray_tracer::init_extend()
         {
-            // shader
-            auto [pipe, layout] = vulkan::load_compute_shader( "rt_2_extend.comp.spv", device_ctx );
-            extend_pipeline = pipe; extend_layout = layout;
-
-            // descriptor set
-            // will be created when a world is bound
+            // shader & descriptor set
+            // will be created when a world is bound, the traversal is specialized for the world's chunk size
         }
 
         void ray_tracer::init_shade()
@@ -187,8 +183,7 @@ namespace rebel_road
         void ray_tracer::init_connect()
         {
             // shader
-            auto [pipe, layout] = vulkan::load_compute_shader( "rt_4_connect.comp.spv", device_ctx );
-            connect_pipeline = pipe; connect_layout = layout;
+            // will be created when a world is bound, the traversal is specialized for the world's chunk size
         }
 
         void ray_tracer::bind_world( std::shared_ptr<world> in_world )
@@ -196,15 +191,37 @@ namespace rebel_road
             // Currently this code assumes a world will always be bound just after creation.
             voxel_world = in_world;
 
+            // shaders
+            const int specialized_chunk_size = voxel_world->get_specialized_chunk_size();
+            vk::SpecializationMapEntry chunk_size_entry { 0, 0, sizeof( int ) };
+            vk::SpecializationInfo specialization { 1, &chunk_size_entry, sizeof( int ), &specialized_chunk_size };
+            {
+                auto [pipe, layout] = vulkan::load_compute_shader( "rt_2_extend.comp.spv", device_ctx, &specialization );
+                extend_pipeline = pipe; extend_layout = layout;
+            }
+            {
+                auto [pipe, layout] = vulkan::load_compute_shader( "rt_4_connect.comp.spv", device_ctx, &specialization );
+                connect_pipeline = pipe; connect_layout = layout;
+            }
+
+            // descriptor sets
+
             vulkan::descriptor_builder::begin( render_ctx->get_descriptor_layout_cache(), render_ctx->get_descriptor_allocator() )
                 .bind_buffer( 0, voxel_world->get_index_buffer_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
                 .bind_buffer( 1, voxel_world->get_brick_buffer_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
                 .bind_buffer( 2, voxel_world->get_world_buffer_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
                 .bind_buffer( 3, voxel_world->get_load_queue_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 4, voxel_world->get_brick_stamp_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 5, voxel_world->get_brick_occupancy_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 6, voxel_world->get_chunk_occupancy_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
                 .build( extend_set );
 
             vulkan::descriptor_builder::begin( render_ctx->get_descriptor_layout_cache(), render_ctx->get_descriptor_allocator() )
                 .bind_buffer( 0, voxel_world->get_world_buffer_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 1, voxel_world->get_index_buffer_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 2, voxel_world->get_brick_material_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 3, voxel_world->get_material_index_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 4, voxel_world->get_material_color_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
                 .build( world_set );
         }
 
@@ -266,9 +283,15 @@ namespace rebel_road
                 memory_barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
                 memory_barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
 
+                // The counters of the last frame, before the global state update zeroes them.
+                const gpu_wavefront_state* state = global_state.mapped_data();
+                average_iterations = state->extend_iteration_rays > 0 ? state->extend_iterations / double( state->extend_iteration_rays ) : 0.0;
+
                 // This seems incorrect.
                 global_state.mapped_data()->primary_ray_count = 0;
 
+                voxel_world->record_request_capacity( cmd );
+
                 // Compute - Primary Rays
                 {
                     //TracyVkZone( render_ctx->get_tracy_context(), cmd, "Primary Rays" );
@@ -276,6 +299,8 @@ namespace rebel_road
                     push_constants.frame = frame;
                     push_constants.render_width = render_extent.width;
                     push_constants.render_height = render_extent.height;
+                    push_constants.trace_frame = voxel_world->get_trace_frame();
+                    push_constants.request_capacity = voxel_world->get_request_capacity();
                     cmd.pushConstants( primary_rays_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof( push_constants ), &push_constants );
 
                     descriptor_sets = { primary_rays_set[primary_rays_index], global_state_set, blit_set_c };
@@ -385,7 +410,8 @@ namespace rebel_road
             timeline_info.pSignalSemaphoreValues = &signal_value;
 
             vk::SubmitInfo submit_info = vulkan::submit_info( &cmd );
-            vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eComputeShader;
+            // The request capacity is written by a transfer, into the queue the streaming thread may still be reading.
+            vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader;
             vk::Semaphore wait_semaphore = voxel_world->get_ray_tracer_wait_semaphore();
             vk::Semaphore signal_semaphore = voxel_world->get_ray_tracer_signal_semaphore();
 
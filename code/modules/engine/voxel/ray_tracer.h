@@ -52,6 +52,8 @@ namespace rebel_road
             uint32_t ray_number_shade {};
             uint32_t ray_number_connect {};
             uint32_t ray_queue_buffer_size { rq_buf_size };
+            uint32_t extend_iterations {};          // Traversal steps of the extended rays, only counted in the iterations render modes.
+            uint32_t extend_iteration_rays {};
         };
 
         struct gpu_push_constants
@@ -59,7 +61,7 @@ namespace rebel_road
             uint32_t frame {};
             uint32_t render_width {};
             uint32_t render_height {};
-            uint32_t pad0 {};
+            uint32_t trace_frame {};                // Stamped on the bricks the traversal visits and selects its request queue, see world::get_trace_frame.
             glm::vec4 camera_direction {};
             glm::vec4 camera_up {};
             glm::vec4 camera_right {};
@@ -69,6 +71,7 @@ namespace rebel_road
             uint32_t enable_depth_of_field {};
             uint32_t render_mode {};
             glm::vec2 sun_position {};
+            uint32_t request_capacity {};           // Most brick requests a trace may queue, see world::set_request_capacity.
         };
 
         class ray_tracer
@@ -88,6 +91,9 @@ namespace rebel_road
             void compute_rays();
             void draw( vk::CommandBuffer cmd );
 
+            // Traversal steps per extended ray of the latest frame, in the iterations render modes.
+            double get_average_iterations() const { return average_iterations; }
+
             // temp:
             glm::vec2 sun_position { 0.005, 0.1 };
             uint32_t render_mode{};
@@ -148,6 +154,7 @@ namespace rebel_road
             util::deletion_queue deletion_queue;
 
             uint32_t frame {};
+            double average_iterations {};
 
             std::shared_ptr<world> voxel_world;
         };
@@ -0,0 +1,471 @@
+#include "voxel_volume.h"
+#include "jobs/job_system.h"
+
+#include <cstring>
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+        namespace
+        {
+            // Reads the little endian chunks of a .vox file out of its mapping, failing instead of running past the end.
+            struct vox_reader
+            {
+                const std::byte* data {};
+                size_t size {};
+                size_t pos {};
+
+                template<typename T>
+                bool read( T& out )
+                {
+                    if ( sizeof( T ) > size - pos )
+                    {
+                        return false;
+                    }
+                    std::memcpy( &out, data + pos, sizeof( T ) );
+                    pos += sizeof( T );
+                    return true;
+                }
+
+                bool read_string( std::string& out )
+                {
+                    int32_t length {};
+                    if ( !read( length ) || length < 0 || size_t( length ) > size - pos )
+                    {
+                        return false;
+                    }
+                    out.assign( reinterpret_cast<const char*>( data + pos ), length );
+                    pos += length;
+                    return true;
+                }
+
+                bool read_dict( std::unordered_map<std::string, std::string>& out )
+                {
+                    int32_t entries {};
+                    if ( !read( entries ) || entries < 0 )
+                    {
+                        return false;
+                    }
+                    for ( int32_t i = 0; i < entries; i++ )
+                    {
+                        std::string key, value;
+                        if ( !read_string( key ) || !read_string( value ) )
+                        {
+                            return false;
+                        }
+                        out[key] = value;
+                    }
+                    return true;
+                }
+            };
+
+            constexpr uint32_t vox_id( const char ( &id )[5] )
+            {
+                return uint32_t( uint8_t( id[0] ) ) | uint32_t( uint8_t( id[1] ) ) << 8 | uint32_t( uint8_t( id[2] ) ) << 16 | uint32_t( uint8_t( id[3] ) ) << 24;
+            }
+
+            struct vox_model
+            {
+                glm::ivec3 size {};
+                const uint8_t* voxels {};       // x, y, z, color for each voxel.
+                uint32_t count {};
+            };
+
+            // A node of the scene graph. Transforms have one child, groups many and shapes reference models.
+            struct vox_node
+            {
+                glm::ivec3 translation {};
+                std::vector<int32_t> children;
+                std::vector<int32_t> models;
+            };
+
+            struct vox_placement
+            {
+                uint32_t model;
+                glm::ivec3 offset;              // Of the model's voxel 0.
+            };
+
+            // Voxels binned per job, at most this many.
+            constexpr uint32_t vox_bin_voxels = 1 << 16;
+        }
+
+        std::unique_ptr<voxel_volume> voxel_volume::open( const std::string& path, const glm::ivec3& raw_size )
+        {
+            auto begin = std::chrono::steady_clock::now();
+
+            auto volume = std::make_unique<voxel_volume>();
+            const bool is_vox = path.size() >= 4 && path.compare( path.size() - 4, 4, ".vox" ) == 0;
+            if ( !( is_vox ? volume->read_vox( path ) : volume->map_raw( path, raw_size ) ) )
+            {
+                return nullptr;
+            }
+
+            volume->read_ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - begin ).count();
+            return volume;
+        }
+
+        bool voxel_volume::map_raw( const std::string& path, const glm::ivec3& raw_size )
+        {
+            format = voxel_volume_format::raw;
+
+            if ( glm::any( glm::lessThanEqual( raw_size, glm::ivec3( 0 ) ) ) )
+            {
+                spdlog::error( "A raw volume needs its size, {} has none.", path );
+                return false;
+            }
+
+            file = io::mapped_file::create( path );
+            if ( !file->is_open() )
+            {
+                spdlog::error( "Unable to open volume {}.", path );
+                return false;
+            }
+
+            const uint64_t voxels = uint64_t( raw_size.x ) * raw_size.y * raw_size.z;
+            raw = file->at<uint8_t>( 0, voxels );
+            if ( !raw )
+            {
+                spdlog::error( "Raw volume {} is smaller than {}x{}x{} voxels.", path, raw_size.x, raw_size.y, raw_size.z );
+                return false;
+            }
+
+            // The grid is read from the mapping as chunks are built, so opening costs nothing up front.
+            size = raw_size;
+            source_voxels = voxels;
+            return true;
+        }
+
+        bool voxel_volume::read_vox( const std::string& path )
+        {
+            format = voxel_volume_format::vox;
+
+            auto vox_file = io::mapped_file::create( path );
+            if ( !vox_file->is_open() )
+            {
+                spdlog::error( "Unable to open volume {}.", path );
+                return false;
+            }
+
+            vox_reader reader { vox_file->get_data(), vox_file->get_size() };
+            uint32_t magic {}, version {}, main_id {}, main_content {}, main_children {};
+            if ( !reader.read( magic ) || magic != vox_id( "VOX " ) || !reader.read( version )
+                || !reader.read( main_id ) || main_id != vox_id( "MAIN" ) || !reader.read( main_content ) || !reader.read( main_children ) )
+            {
+                spdlog::error( "{} is not a MagicaVoxel file.", path );
+                return false;
+            }
+
+            std::vector<vox_model> models;
+            std::unordered_map<int32_t, vox_node> nodes;
+
+            reader.pos += main_content;
+            const size_t end = std::min( reader.size, reader.pos + main_children );
+            while ( reader.pos + 12 <= end )
+            {
+                uint32_t id {}, content {}, children {};
+                reader.read( id );
+                reader.read( content );
+                reader.read( children );
+                const size_t next = reader.pos + content + children;
+                if ( next > end )
+                {
+                    spdlog::error( "MagicaVoxel file {} is truncated.", path );
+                    return false;
+                }
+
+                vox_reader chunk { reader.data, reader.pos + content, reader.pos };
+                bool valid = true;
+                if ( id == vox_id( "SIZE" ) )
+                {
+                    vox_model model;
+                    valid = chunk.read( model.size.x ) && chunk.read( model.size.y ) && chunk.read( model.size.z );
+                    models.push_back( model );
+                }
+                else if ( id == vox_id( "XYZI" ) )
+                {
+                    // Each XYZI belongs to the SIZE before it.
+                    valid = !models.empty() && chunk.read( models.back().count ) && uint64_t( models.back().count ) * 4 <= chunk.size - chunk.pos;
+                    if ( valid )
+                    {
+                        models.back().voxels = reinterpret_cast<const uint8_t*>( chunk.data + chunk.pos );
+                    }
+                }
+                else if ( id == vox_id( "RGBA" ) )
+                {
+                    // Color index i of the voxels is entry i - 1 of the palette.
+                    for ( int i = 0; valid && i < material_count - 1; i++ )
+                    {
+                        valid = chunk.read( colors[i + 1] );
+                    }
+                }
+                else if ( id == vox_id( "nTRN" ) || id == vox_id( "nGRP" ) || id == vox_id( "nSHP" ) )
+                {
+                    int32_t node_id {};
+                    std::unordered_map<std::string, std::string> attributes;
+                    valid = chunk.read( node_id ) && chunk.read_dict( attributes );
+                    vox_node& node = nodes[node_id];
+
+                    if ( valid && id == vox_id( "nTRN" ) )
+                    {
+                        int32_t child {}, reserved {}, layer {}, frames {};
+                        valid = chunk.read( child ) && chunk.read( reserved ) && chunk.read( layer ) && chunk.read( frames );
+                        node.children.push_back( child );
+
+                        // Only the first frame's translation is used. Rotations are not supported.
+                        std::unordered_map<std::string, std::string> frame;
+                        if ( valid && frames > 0 && chunk.read_dict( frame ) )
+                        {
+                            if ( auto translation = frame.find( "_t" ); translation != frame.end() )
+                            {
+                                std::istringstream( translation->second ) >> node.translation.x >> node.translation.y >> node.translation.z;
+                            }
+                        }
+                    }
+                    else if ( valid && id == vox_id( "nGRP" ) )
+                    {
+                        int32_t count {};
+                        valid = chunk.read( count );
+                        for ( int32_t i = 0; valid && i < count; i++ )
+                        {
+                            int32_t child {};
+                            valid = chunk.read( child );
+                            node.children.push_back( child );
+                        }
+                    }
+                    else if ( valid )
+                    {
+                        int32_t count {};
+                        valid = chunk.read( count );
+                        for ( int32_t i = 0; valid && i < count; i++ )
+                        {
+                            int32_t model {};
+                            std::unordered_map<std::string, std::string> model_attributes;
+                            valid = chunk.read( model ) && chunk.read_dict( model_attributes );
+                            node.models.push_back( model );
+                        }
+                    }
+                }
+
+                if ( !valid )
+                {
+                    spdlog::error( "MagicaVoxel file {} has a corrupt {} chunk.", path, std::string( reinterpret_cast<const char*>( &id ), 4 ) );
+                    return false;
+                }
+
+                reader.pos = next;
+            }
+
+            // Walk the scene graph from its root, adding up translations. A model is centered on its translation.
+            // Files without a scene graph hold a single model at the origin.
+            std::vector<vox_placement> placements;
+            if ( nodes.empty() )
+            {
+                for ( uint32_t m = 0; m < models.size(); m++ )
+                {
+                    placements.push_back( { m, glm::ivec3( 0 ) } );
+                }
+            }
+            else
+            {
+                std::function<void( int32_t, glm::ivec3, int )> place = [&] ( int32_t node_id, glm::ivec3 translation, int depth )
+                {
+                    auto found = nodes.find( node_id );
+                    if ( found == nodes.end() || depth > 64 )
+                    {
+                        return;
+                    }
+
+                    translation += found->second.translation;
+                    for ( int32_t model : found->second.models )
+                    {
+                        if ( model >= 0 && model < static_cast<int32_t>( models.size() ) )
+                        {
+                            placements.push_back( { uint32_t( model ), translation - models[model].size / 2 } );
+                        }
+                    }
+                    for ( int32_t child : found->second.children )
+                    {
+                        place( child, translation, depth + 1 );
+                    }
+                };
+                place( 0, glm::ivec3( 0 ), 0 );
+            }
+
+            if ( placements.empty() )
+            {
+                spdlog::error( "MagicaVoxel file {} has no models.", path );
+                return false;
+            }
+
+            // Move the scene to start at the origin.
+            glm::ivec3 low( std::numeric_limits<int>::max() ), high( std::numeric_limits<int>::min() );
+            for ( const auto& placement : placements )
+            {
+                low = glm::min( low, placement.offset );
+                high = glm::max( high, placement.offset + models[placement.model].size - 1 );
+            }
+            size = high - low + 1;
+
+            // Split every model's voxels into jobs of at most vox_bin_voxels. Each job bins its voxels into bricks of its own.
+            struct bin_job
+            {
+                uint32_t placement;
+                uint32_t first;
+                uint32_t count;
+            };
+            std::vector<bin_job> bin_jobs;
+            for ( uint32_t p = 0; p < placements.size(); p++ )
+            {
+                const auto& model = models[placements[p].model];
+                source_voxels += model.count;
+                for ( uint32_t first = 0; first < model.count; first += vox_bin_voxels )
+                {
+                    bin_jobs.push_back( { p, first, std::min( vox_bin_voxels, model.count - first ) } );
+                }
+            }
+
+            std::vector<std::unordered_map<uint64_t, sparse_brick>> binned( bin_jobs.size() );
+            jobs::job_system_locator::get()->parallel_for( static_cast<uint32_t>( bin_jobs.size() ), 1, [&] ( uint32_t begin, uint32_t end )
+                {
+                    for ( uint32_t j = begin; j < end; j++ )
+                    {
+                        const auto& job = bin_jobs[j];
+                        const auto& model = models[placements[job.placement].model];
+                        const glm::ivec3 offset = placements[job.placement].offset - low;
+                        auto& bricks = binned[j];
+
+                        const uint8_t* voxel = model.voxels + size_t( job.first ) * 4;
+                        for ( uint32_t v = 0; v < job.count; v++, voxel += 4 )
+                        {
+                            const glm::ivec3 local( voxel[0], voxel[1], voxel[2] );
+                            if ( glm::any( glm::greaterThanEqual( local, model.size ) ) )
+                            {
+                                continue;
+                            }
+
+                            const glm::ivec3 pos = offset + local;
+                            const glm::ivec3 in_brick = pos % brick_size;
+                            const int bit = in_brick.x + in_brick.y * brick_size + in_brick.z * brick_size * brick_size;
+                            sparse_brick& binned_brick = bricks[brick_key( pos / brick_size )];
+                            binned_brick.mask.data[bit / 32] |= 1u << ( bit % 32 );
+                            binned_brick.materials[bit] = voxel[3];
+                        }
+                    }
+                } );
+
+            for ( auto& bricks : binned )
+            {
+                if ( sparse_bricks.empty() )
+                {
+                    sparse_bricks = std::move( bricks );
+                    continue;
+                }
+
+                for ( const auto& [key, binned_brick] : bricks )
+                {
+                    auto [it, inserted] = sparse_bricks.try_emplace( key, binned_brick );
+                    if ( !inserted )
+                    {
+                        // Models overlapping in a brick, the later one wins where both have a voxel.
+                        for ( int bit = 0; bit < brick_size * brick_size * brick_size; bit++ )
+                        {
+                            if ( binned_brick.mask.data[bit / 32] & ( 1u << ( bit % 32 ) ) )
+                            {
+                                it->second.materials[bit] = binned_brick.materials[bit];
+                            }
+                        }
+                        for ( int w = 0; w < cell_members; w++ )
+                        {
+                            it->second.mask.data[w] |= binned_brick.mask.data[w];
+                        }
+                    }
+                }
+            }
+
+            spdlog::info( "Read {}: {} models, {}x{}x{} voxels, {} filled in {} bricks", path, placements.size(), size.x, size.y, size.z, source_voxels, sparse_bricks.size() );
+            return true;
+        }
+
+        bool voxel_volume::brick_mask( const glm::ivec3& brick_origin, brick& out ) const
+        {
+            const glm::ivec3 lo = glm::max( brick_origin, glm::ivec3( 0 ) );
+            const glm::ivec3 hi = glm::min( brick_origin + brick_size - 1, size - 1 );
+            if ( glm::any( glm::greaterThan( lo, hi ) ) )
+            {
+                return false;
+            }
+
+            if ( format == voxel_volume_format::vox )
+            {
+                // Bricks were binned on the brick grid of the volume.
+                assert( brick_origin % brick_size == glm::ivec3( 0 ) );
+                auto found = sparse_bricks.find( brick_key( brick_origin / brick_size ) );
+                if ( found == sparse_bricks.end() )
+                {
+                    return false;
+                }
+                for ( int w = 0; w < cell_members; w++ )
+                {
+                    out.data[w] |= found->second.mask.data[w];
+                }
+                return true;
+            }
+
+            // One row of the grid at a time becomes a byte of a brick word.
+            bool any = false;
+            for ( int z = lo.z; z <= hi.z; z++ )
+            {
+                for ( int y = lo.y; y <= hi.y; y++ )
+                {
+                    const uint8_t* row = raw + ( size_t( z ) * size.y + y ) * size.x;
+                    uint32_t bits = 0;
+                    for ( int x = lo.x; x <= hi.x; x++ )
+                    {
+                        bits |= uint32_t( row[x] != 0 ) << ( x - brick_origin.x );
+                    }
+
+                    if ( bits != 0 )
+                    {
+                        const int bit = ( y - brick_origin.y ) * brick_size + ( z - brick_origin.z ) * brick_size * brick_size;
+                        out.data[bit / 32] |= bits << ( bit % 32 );
+                        any = true;
+                    }
+                }
+            }
+            return any;
+        }
+
+        void voxel_volume::brick_materials( const glm::ivec3& brick_origin, uint8_t* out ) const
+        {
+            constexpr int voxels = brick_size * brick_size * brick_size;
+
+            if ( format == voxel_volume_format::vox )
+            {
+                auto found = sparse_bricks.find( brick_key( brick_origin / brick_size ) );
+                if ( found != sparse_bricks.end() )
+                {
+                    std::memcpy( out, found->second.materials, voxels );
+                }
+                return;
+            }
+
+            // The voxel bytes are the materials. Voxels outside the grid are empty, their material does not matter.
+            const glm::ivec3 lo = glm::max( brick_origin, glm::ivec3( 0 ) );
+            const glm::ivec3 hi = glm::min( brick_origin + brick_size - 1, size - 1 );
+            std::memset( out, 0, voxels );
+            for ( int z = lo.z; z <= hi.z; z++ )
+            {
+                for ( int y = lo.y; y <= hi.y; y++ )
+                {
+                    const uint8_t* row = raw + ( size_t( z ) * size.y + y ) * size.x;
+                    const int bit = ( y - brick_origin.y ) * brick_size + ( z - brick_origin.z ) * brick_size * brick_size - brick_origin.x;
+                    for ( int x = lo.x; x <= hi.x; x++ )
+                    {
+                        out[bit + x] = row[x];
+                    }
+                }
+            }
+        }
+    }
+}
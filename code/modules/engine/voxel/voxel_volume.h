@@ -0,0 +1,69 @@
+#pragma once
+
+#include "material.h"
+#include "io/mapped_file.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+        enum class voxel_volume_format : uint8_t
+        {
+            vox,        // MagicaVoxel .vox, every model of the scene placed by its translation.
+            raw,        // Dense grid of one byte per voxel, x fastest then y then z. Non zero bytes are filled, the byte is the voxel's material.
+        };
+
+        // Occupancy and materials read from an external file, sampled a brick at a time to build chunks.
+        // brick_mask and brick_materials are safe to call from many threads at once.
+        class voxel_volume
+        {
+        public:
+            // A .vox file, or a raw grid of raw_size voxels for any other extension.
+            static std::unique_ptr<voxel_volume> open( const std::string& path, const glm::ivec3& raw_size = {} );
+
+            voxel_volume() = default;
+            voxel_volume( const voxel_volume& ) = delete;
+            voxel_volume& operator=( const voxel_volume& ) = delete;
+
+            voxel_volume_format get_format() const { return format; }
+            // Bounds of the volume in voxels, starting at the origin.
+            glm::ivec3 get_size() const { return size; }
+            // Voxels listed by a .vox file, or every voxel of a raw grid.
+            uint64_t get_source_voxels() const { return source_voxels; }
+            double get_read_ms() const { return read_ms; }
+            // The .vox palette, material i being color index i of the file. Gray for raw grids and .vox files without a palette.
+            const material_colors& get_colors() const { return colors; }
+
+            // Sets the bits of the filled voxels of the brick at brick_origin, in voxels of the volume. Returns false when there are none.
+            bool brick_mask( const glm::ivec3& brick_origin, brick& out ) const;
+            // The material of every voxel of the same brick, numbered as the bits of brick::data. Only those of filled voxels are meaningful.
+            void brick_materials( const glm::ivec3& brick_origin, uint8_t* out ) const;
+
+        private:
+            struct sparse_brick
+            {
+                brick mask {};
+                uint8_t materials[brick_size * brick_size * brick_size] {};
+            };
+
+            bool read_vox( const std::string& path );
+            bool map_raw( const std::string& path, const glm::ivec3& raw_size );
+
+            static uint64_t brick_key( const glm::ivec3& brick_pos ) { return ( uint64_t( brick_pos.z ) << 42 ) | ( uint64_t( brick_pos.y ) << 21 ) | uint64_t( brick_pos.x ); }
+
+            voxel_volume_format format { voxel_volume_format::raw };
+            glm::ivec3 size {};
+            uint64_t source_voxels {};
+            double read_ms {};
+            material_colors colors = make_gray_colors();
+
+            std::shared_ptr<io::mapped_file> file;      // Raw grids are read straight from the mapping.
+            const uint8_t* raw {};
+            std::unordered_map<uint64_t, sparse_brick> sparse_bricks;      // .vox voxels binned into bricks, keyed by brick_key.
+        };
+    }
+}
@@ -0,0 +1,255 @@
+#include "voxelize.h"
+
+#include <bit>
+#include <chrono>
+#include <random>
+
+#if defined( _M_X64 ) || defined( __x86_64__ )
+    #define VOXELIZE_X86 1
+    #include <immintrin.h>
+    #if defined( _MSC_VER )
+        #include <intrin.h>
+        #define VOXELIZE_AVX2
+    #else
+        #define VOXELIZE_AVX2 __attribute__( ( target( "avx2" ) ) )
+    #endif
+#endif
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+        namespace
+        {
+            // The loop generate_chunk used before voxelize_columns, kept as the benchmark baseline.
+            void voxelize_per_voxel( const uint8_t* fill, brick& out, uint32_t& lod_2x2x2 )
+            {
+                out = {};
+                lod_2x2x2 = 0;
+                for ( int cell_x = 0; cell_x < brick_size; cell_x++ )
+                {
+                    for ( int cell_y = 0; cell_y < brick_size; cell_y++ )
+                    {
+                        for ( int cell_z = 0; cell_z < brick_size; cell_z++ )
+                        {
+                            if ( cell_z < fill[cell_x + cell_y * brick_size] )
+                            {
+                                uint32_t sub_data = ( cell_x + cell_y * brick_size + cell_z * brick_size * brick_size ) / ( sizeof( uint32_t ) * 8 );
+                                uint32_t bit_position = ( cell_x + cell_y * brick_size + cell_z * brick_size * brick_size ) % ( sizeof( uint32_t ) * 8 );
+                                out.data[sub_data] |= ( 1 << bit_position );
+                                lod_2x2x2 |= 1 << ( ( ( cell_x & 0b100 ) >> 2 ) + ( ( cell_y & 0b100 ) >> 1 ) + ( cell_z & 0b100 ) );
+                            }
+                        }
+                    }
+                }
+            }
+
+#ifdef VOXELIZE_X86
+            VOXELIZE_AVX2 void voxelize_columns_avx2( const uint8_t* fill, brick& out )
+            {
+                // Word z * 2 + half covers columns half * 32 to half * 32 + 31, bit i being column half * 32 + i.
+                // movemask packs exactly that: bit i is the sign of byte i.
+                const __m256i low = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( fill ) );
+                const __m256i high = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( fill + 32 ) );
+                for ( int z = 0; z < brick_size; z++ )
+                {
+                    const __m256i level = _mm256_set1_epi8( static_cast<char>( z ) );
+                    out.data[z * 2] = static_cast<uint32_t>( _mm256_movemask_epi8( _mm256_cmpgt_epi8( low, level ) ) );
+                    out.data[z * 2 + 1] = static_cast<uint32_t>( _mm256_movemask_epi8( _mm256_cmpgt_epi8( high, level ) ) );
+                }
+            }
+#endif
+
+            bool detect_avx2()
+            {
+#if defined( VOXELIZE_X86 ) && defined( _MSC_VER )
+                int info[4] {};
+                __cpuid( info, 1 );
+                const bool os_saves_ymm = ( info[2] & ( 1 << 27 ) ) && ( info[2] & ( 1 << 28 ) ) && ( _xgetbv( 0 ) & 6 ) == 6;
+                if ( !os_saves_ymm )
+                {
+                    return false;
+                }
+                __cpuidex( info, 7, 0 );
+                return ( info[1] & ( 1 << 5 ) ) != 0;
+#elif defined( VOXELIZE_X86 )
+                return __builtin_cpu_supports( "avx2" );
+#else
+                return false;
+#endif
+            }
+        }
+
+        bool voxelize_has_avx2()
+        {
+            static const bool has_avx2 = detect_avx2();
+            return has_avx2;
+        }
+
+        void voxelize_columns_scalar( const uint8_t* fill, brick& out )
+        {
+            for ( int z = 0; z < brick_size; z++ )
+            {
+                for ( int half = 0; half < 2; half++ )
+                {
+                    const uint8_t* columns = fill + half * 32;
+                    uint32_t word = 0;
+                    for ( int i = 0; i < 32; i++ )
+                    {
+                        word |= uint32_t( columns[i] > z ) << i;
+                    }
+                    out.data[z * 2 + half] = word;
+                }
+            }
+        }
+
+        void voxelize_columns( const uint8_t* fill, brick& out )
+        {
+#ifdef VOXELIZE_X86
+            if ( voxelize_has_avx2() )
+            {
+                voxelize_columns_avx2( fill, out );
+                return;
+            }
+#endif
+            voxelize_columns_scalar( fill, out );
+        }
+
+        uint32_t brick_lod_2x2x2( const brick& b )
+        {
+            // Within a word, x < 4 is the low nibble of each byte and y is the byte. The word index gives the y and z halves.
+            uint32_t lod = 0;
+            for ( int w = 0; w < cell_members; w++ )
+            {
+                const uint32_t octant = ( ( w & 1 ) << 1 ) | ( w >= cell_members / 2 ? 4 : 0 );
+                if ( b.data[w] & 0x0F0F0F0Fu )
+                {
+                    lod |= 1u << octant;
+                }
+                if ( b.data[w] & 0xF0F0F0F0u )
+                {
+                    lod |= 1u << ( octant | 1 );
+                }
+            }
+            return lod;
+        }
+
+        uint64_t brick_occupancy_4x4x4( const brick& b )
+        {
+            // A word is four rows of one z slice. OR the rows in pairs, then the x voxels in pairs, and pack the eight blocks into a byte.
+            // The two z slices of a block OR into the same byte.
+            uint64_t occupancy = 0;
+            for ( int w = 0; w < cell_members; w++ )
+            {
+                uint32_t r = ( b.data[w] | ( b.data[w] >> 8 ) ) & 0x00FF00FFu;
+                r = ( r | ( r >> 1 ) ) & 0x00550055u;
+                r = ( r | ( r >> 1 ) ) & 0x00330033u;
+                r = ( r | ( r >> 2 ) ) & 0x000F000Fu;
+                const uint64_t blocks = ( r & 0xFu ) | ( ( r >> 16 ) << 4 );
+                occupancy |= blocks << ( ( w / 4 ) * 16 + ( w % 2 ) * 8 );
+            }
+            return occupancy;
+        }
+
+        void brick_region_mask( const glm::ivec3& lo, const glm::ivec3& hi, brick& out )
+        {
+            // Every row of the region is the same run of x bits. A word holds four rows of one z slice.
+            const uint32_t row = ( 0xFFu >> ( brick_size - 1 - ( hi.x - lo.x ) ) ) << lo.x;
+            for ( int z = lo.z; z <= hi.z; z++ )
+            {
+                for ( int y = lo.y; y <= hi.y; y++ )
+                {
+                    const int bit = y * brick_size + z * brick_size * brick_size;
+                    out.data[bit / 32] |= row << ( bit % 32 );
+                }
+            }
+        }
+
+        uint32_t brick_voxel_count( const brick& b )
+        {
+            uint32_t count = 0;
+            for ( uint32_t word : b.data )
+            {
+                count += std::popcount( word );
+            }
+            return count;
+        }
+
+        voxelize_benchmark_result benchmark_voxelize( uint32_t brick_count )
+        {
+            // Random surface bricks, the only kind generate_chunk voxelizes. Empty and full bricks are detected from the fills.
+            std::mt19937 rng( 1234 );
+            std::uniform_int_distribution<int> distribution( 0, brick_size );
+            std::vector<uint8_t> fills( size_t( brick_count ) * brick_columns );
+            for ( auto& fill : fills )
+            {
+                fill = static_cast<uint8_t>( distribution( rng ) );
+            }
+
+            std::vector<brick> expected( brick_count );
+            std::vector<brick> result( brick_count );
+
+            auto time_ms = [&] ( auto&& voxelize_all )
+            {
+                auto begin = std::chrono::steady_clock::now();
+                voxelize_all();
+                return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - begin ).count();
+            };
+
+            voxelize_benchmark_result benchmark;
+            benchmark.bricks = brick_count;
+
+            std::vector<uint32_t> expected_lods( brick_count );
+            benchmark.per_voxel_ms = time_ms( [&] ()
+                {
+                    for ( uint32_t i = 0; i < brick_count; i++ )
+                    {
+                        voxelize_per_voxel( &fills[size_t( i ) * brick_columns], expected[i], expected_lods[i] );
+                    }
+                } );
+
+            auto verify = [&] ( const char* name )
+            {
+                for ( uint32_t i = 0; i < brick_count; i++ )
+                {
+                    if ( !( result[i] == expected[i] ) || brick_lod_2x2x2( result[i] ) != expected_lods[i] )
+                    {
+                        spdlog::error( "Voxelize benchmark: {} disagrees with the per voxel loop at brick {}.", name, i );
+                        return;
+                    }
+                }
+            };
+
+            benchmark.scalar_ms = time_ms( [&] ()
+                {
+                    for ( uint32_t i = 0; i < brick_count; i++ )
+                    {
+                        voxelize_columns_scalar( &fills[size_t( i ) * brick_columns], result[i] );
+                    }
+                } );
+            verify( "scalar" );
+
+#ifdef VOXELIZE_X86
+            if ( voxelize_has_avx2() )
+            {
+                benchmark.avx2_ms = time_ms( [&] ()
+                    {
+                        for ( uint32_t i = 0; i < brick_count; i++ )
+                        {
+                            voxelize_columns_avx2( &fills[size_t( i ) * brick_columns], result[i] );
+                        }
+                    } );
+                verify( "AVX2" );
+            }
+#endif
+
+            spdlog::info( "Voxelize benchmark, {} bricks: per voxel {:.2f} ms, scalar {:.2f} ms ({:.1f}x), AVX2 {:.2f} ms ({:.1f}x)",
+                brick_count,
+                benchmark.per_voxel_ms,
+                benchmark.scalar_ms, benchmark.per_voxel_ms / std::max( benchmark.scalar_ms, 1e-6 ),
+                benchmark.avx2_ms, benchmark.avx2_ms > 0 ? benchmark.per_voxel_ms / benchmark.avx2_ms : 0.0 );
+
+            return benchmark;
+        }
+    }
+}
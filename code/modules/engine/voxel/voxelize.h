@@ -0,0 +1,42 @@
+#pragma once
+
+#include "brick.h"
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+        // Per column fill of a brick: how many voxels, from the bottom of the brick up, are set in each column.
+        // Column index: cell_x + cell_y * brick_size. Values are 0 - brick_size.
+        constexpr static int brick_columns = brick_size * brick_size;
+
+        // Builds the brick words from column fills, using AVX2 when the CPU supports it.
+        // A brick word holds a 4x8 slice of columns at a single z, so each word is a compare of 32 fills against z.
+        void voxelize_columns( const uint8_t* fill, brick& out );
+        void voxelize_columns_scalar( const uint8_t* fill, brick& out );
+        bool voxelize_has_avx2();
+
+        // The 2x2x2 LOD byte of a brick, one bit per 4x4x4 octant that contains any set voxel.
+        uint32_t brick_lod_2x2x2( const brick& b );
+
+        // The 4x4x4 occupancy of a brick, one bit per 2x2x2 block of voxels that contains any set voxel.
+        // Bit index: x + y * 4 + z * 16, in blocks. world_upload_bricks.comp computes the same summary when it places a brick.
+        uint64_t brick_occupancy_4x4x4( const brick& b );
+
+        // Sets the bits of every voxel in [lo, hi], in voxels within the brick. Everything else in out is left as is.
+        void brick_region_mask( const glm::ivec3& lo, const glm::ivec3& hi, brick& out );
+
+        uint32_t brick_voxel_count( const brick& b );
+
+        struct voxelize_benchmark_result
+        {
+            double per_voxel_ms {};     // The original generate_chunk loop, one bit at a time.
+            double scalar_ms {};
+            double avx2_ms {};          // 0 when AVX2 is unavailable.
+            uint32_t bricks {};
+        };
+
+        // Voxelizes the same random bricks with each method, checks they agree and logs the timings.
+        voxelize_benchmark_result benchmark_voxelize( uint32_t brick_count = 1 << 18 );
+    }
+}
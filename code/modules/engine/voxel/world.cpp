@@ -1,4 +1,7 @@
 #include "world.h"
+#include "world_file.h"
+#include "voxelize.h"
+#include "jobs/job_system.h"
 #include "SimplexNoise.h"
 #include "vulkan/worker.h"
 #include "vulkan/shader.h"
@@ -8,40 +11,86 @@ namespace rebel_road
     namespace voxel
     {
 
-        int get_chunk_index( const glm::ivec3& pos )
+        int world::get_chunk_index( const glm::ivec3& pos ) const
         {
-            return pos.x / chunk_size
-                + ( pos.y / chunk_size ) * world_size.x
-                + ( pos.z / chunk_size ) * world_size.x * world_size.y;
+            return pos.x / dims.chunk_size
+                + ( pos.y / dims.chunk_size ) * world_size.x
+                + ( pos.z / dims.chunk_size ) * world_size.x * world_size.y;
         }
 
-        std::shared_ptr<world> world::create( vulkan::render_context* in_render_ctx )
+        std::shared_ptr<world> world::create( vulkan::render_context* in_render_ctx, const world_dimensions& in_dims )
         {
-            return std::make_shared<world>( in_render_ctx );
+            return std::make_shared<world>( in_render_ctx, in_dims );
         }
 
-        world::world( vulkan::render_context* in_render_ctx )
-            : device_ctx( in_render_ctx->get_device_context() ), render_ctx( in_render_ctx )
+        world::world( vulkan::render_context* in_render_ctx, const world_dimensions& in_dims )
+            : device_ctx( in_render_ctx->get_device_context() ), render_ctx( in_render_ctx ), dims( in_dims )
         {
-            gpu_world_conf.allocate( sizeof( gpu_world_config ), vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY );
-            gpu_world_index_ptrs.allocate( sizeof( gpu_index_pointers ), vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY );
-            gpu_world_brick_ptrs.allocate( sizeof( gpu_brick_pointers ), vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY );
+            if ( !dims.is_valid() )
+            {
+                spdlog::critical( "Invalid world dimensions {}x{}x{} with chunk size {}, using the defaults.", dims.grid_size, dims.grid_size, dims.grid_height, dims.chunk_size );
+                dims = {};
+            }
+
+            world_size = dims.get_world_size();
+            chunk_count = dims.get_chunk_count();
 
-            bricks_requested_by_gpu.allocate( sizeof( gpu_brick_load_queue ), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU );
-            gpu_bricks_to_load.allocate( brick_load_queue_size * sizeof( brick ), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_ONLY );
-            gpu_indices_to_load.allocate( brick_load_queue_size * sizeof( uint32_t ), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_ONLY );
+            world_conf.grid_size = dims.grid_size;
+            world_conf.grid_height = dims.grid_height;
+            world_conf.chunk_size = dims.chunk_size;
+            world_conf.chunk_count = chunk_count;
+            world_conf.world_size = glm::ivec4( world_size, 1 );
+            world_conf.cells = dims.get_cells();
+            world_conf.cells_height = dims.get_cells_height();
+            world_conf.lod_distance_8x8x8 = dims.lod_distance_8x8x8;
+            world_conf.lod_distance_2x2x2 = dims.lod_distance_2x2x2;
+            world_conf.lod_distance_4x4x4 = dims.lod_distance_4x4x4;
+
+            heightmaps = heightmap_cache::create( dims.chunk_size * brick_size, [this] ( int tile_x, int tile_y, heightmap_tile& tile ) { generate_heightmap_tile( tile_x, tile_y, tile ); } );
+
+            world_index_ptrs.resize( chunk_count );
+            chunk_occupancy.resize( ( chunk_count + 31 ) / 32 );
+
+            gpu_world_conf.allocate( sizeof( gpu_world_config ), vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY );
+            gpu_world_index_ptrs.allocate( chunk_count * sizeof( uint64_t ), vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY );
+            gpu_chunk_occupancy.allocate( chunk_occupancy.size() * sizeof( uint32_t ), vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY );
+            gpu_brick_heap.allocate( gpu_brick_heap_capacity * sizeof( brick ), vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY );
+            gpu_brick_occupancy.allocate( gpu_brick_heap_capacity * sizeof( uint64_t ), vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY );
+            brick_slots.reset( gpu_brick_heap_capacity );
+            gpu_material_colors.allocate( material_count * sizeof( uint32_t ), vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY );
+            gpu_brick_materials.allocate( gpu_brick_heap_capacity * sizeof( gpu_brick_material ), vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY );
+            gpu_material_indices.allocate( vk::DeviceSize( gpu_material_block_capacity ) * material_index_words * sizeof( uint32_t ), vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY );
+            material_blocks.reset( gpu_material_block_capacity );
+            slot_material_blocks.assign( gpu_brick_heap_capacity, 0 );
+            // The ray tracer reads and writes the stamps every step, so they stay in device memory. Evictions read a copy.
+            gpu_brick_stamps.allocate( gpu_brick_heap_capacity * sizeof( uint32_t ), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_GPU_ONLY );
+            gpu_brick_stamp_readback.allocate( gpu_brick_heap_capacity * sizeof( uint32_t ), vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU );
+
+            bricks_requested_by_gpu.allocate( brick_request_queue_count * sizeof( gpu_brick_load_queue ), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU );
+            std::memset( bricks_requested_by_gpu.mapped_data(), 0, bricks_requested_by_gpu.size );
+            gpu_brick_payloads.allocate( brick_payload_words * sizeof( uint32_t ), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_ONLY );
+            gpu_placements.allocate( brick_load_queue_size * sizeof( gpu_brick_placement ), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_ONLY );
 
             worker = vulkan::worker::create( device_ctx );
+            worker->immediate_submit( [this] ( vk::CommandBuffer cmd ) { cmd.fillBuffer( gpu_brick_stamps.buf, 0, VK_WHOLE_SIZE, 0 ); } );
 
             // shader
-            auto [pipe, layout] = vulkan::load_compute_shader( "world_upload_bricks.comp.spv", device_ctx );
+            // Bake the chunk size into the shader for the common sizes.
+            const int specialized_chunk_size = get_specialized_chunk_size();
+            vk::SpecializationMapEntry chunk_size_entry { 0, 0, sizeof( int ) };
+            vk::SpecializationInfo specialization { 1, &chunk_size_entry, sizeof( int ), &specialized_chunk_size };
+
+            auto [pipe, layout] = vulkan::load_compute_shader( "world_upload_bricks.comp.spv", device_ctx, &specialization );
             upload_bricks_pipeline = pipe; upload_bricks_layout = layout;
 
             brick_loader_command_pool = device_ctx->create_command_pool( device_ctx->transfer_queue_family, vk::CommandPoolCreateFlagBits::eResetCommandBuffer );
             auto cmd_alloc_info = vulkan::command_buffer_allocate_info( brick_loader_command_pool );
             brick_loader_cmd = device_ctx->device.allocateCommandBuffers( cmd_alloc_info )[0];
+            brick_stamp_cmd = device_ctx->device.allocateCommandBuffers( cmd_alloc_info )[0];
+            brick_stamp_fence = device_ctx->device.createFence( vulkan::fence_create_info() );
 
-            brick_processor_command_pool = device_ctx->create_command_pool( device_ctx->graphics_queue_family, vk::CommandPoolCreateFlagBits::eResetCommandBuffer );
+            // Placement runs on the compute queue so that only the streaming thread ever submits to it.
+            brick_processor_command_pool = device_ctx->create_command_pool( device_ctx->compute_queue_family, vk::CommandPoolCreateFlagBits::eResetCommandBuffer );
             cmd_alloc_info = vulkan::command_buffer_allocate_info( brick_processor_command_pool );
             brick_processor_cmd = device_ctx->device.allocateCommandBuffers( cmd_alloc_info )[0];
 
@@ -57,92 +106,178 @@ namespace rebel_road
 
         world::~world()
         {
-            for ( auto& chunk : chunklist )
-            {
-                chunk->gpu_bricks.free();
-                chunk->gpu_indices.free();
-            }
+            stop_streaming();
+            pager.reset();
+
+            gpu_index_heap.free();
+            gpu_brick_heap.free();
+            gpu_brick_occupancy.free();
+            gpu_brick_stamps.free();
+            gpu_brick_stamp_readback.free();
+            gpu_material_colors.free();
+            gpu_brick_materials.free();
+            gpu_material_indices.free();
 
             gpu_world_conf.free();
             gpu_world_index_ptrs.free();
-            gpu_world_brick_ptrs.free();
+            gpu_chunk_occupancy.free();
 
             bricks_requested_by_gpu.free();
-            gpu_bricks_to_load.free();
-            gpu_indices_to_load.free();
+            gpu_brick_payloads.free();
+            gpu_placements.free();
 
+            device_ctx->device.destroyFence( brick_stamp_fence );
             worker.reset();
         }
 
-        void world::generate_chunk( int start_x, int start_y, int start_z )
+        void world::generate_heightmap_tile( int tile_x, int tile_y, heightmap_tile& tile ) const
         {
             SimplexNoise noise( 1.f, 1.f, 2.f, 0.5f );
 
-            std::vector<float> heights;
-            heights.reserve( chunk_size * brick_size * chunk_size * brick_size );
-
-            for ( int y = 0; y < chunk_size * brick_size; y++ )
+            for ( int y = 0; y < tile.size; y++ )
             {
-                for ( int x = 0; x < chunk_size * brick_size; x++ )
+                for ( int x = 0; x < tile.size; x++ )
                 {
-                    float h = 1 - std::abs( noise.fractal( 7, ( start_x * chunk_size * brick_size + x ) / 1024.f, ( start_y * chunk_size * brick_size + y ) / 1024.f ) );
-                    h *= grid_height;
-                    heights.push_back( h );
+                    float h = 1 - std::abs( noise.fractal( 7, ( tile_x * tile.size + x ) / 1024.f, ( tile_y * tile.size + y ) / 1024.f ) );
+                    h *= dims.grid_height;
+                    tile.heights[x + y * tile.size] = static_cast<uint16_t>( std::ceil( h ) );
                 }
             }
+        }
+
+        void world::generate_column( int x, int y, int min_z, int max_z )
+        {
+            // Every chunk stacked in a column shares the column's heightmap.
+            auto tile = heightmaps->get( x, y );
+
+            for ( int z = min_z; z <= max_z; z++ )
+            {
+                build_chunk( *tile, x, y, z );
+            }
+        }
+
+        void world::build_chunk( const heightmap_tile& tile, int x, int y, int z )
+        {
+            switch ( dims.chunk_size )
+            {
+            case 16: generate_chunk<16>( tile, x, y, z ); break;
+            case 32: generate_chunk<32>( tile, x, y, z ); break;
+            default: generate_chunk<0>( tile, x, y, z ); break;
+            }
+        }
+
+        template<int fixed_chunk_size>
+        void world::generate_chunk( const heightmap_tile& tile, int start_x, int start_y, int start_z )
+        {
+            // A compile time chunk size lets the compiler unroll and strength reduce the loops below.
+            const int chunk_size = fixed_chunk_size != 0 ? fixed_chunk_size : dims.chunk_size;
+            const uint16_t* heights = tile.heights.data();
 
             auto chunk = std::make_unique<voxel::chunk>();
-            chunk->indices.resize( chunk_size * chunk_size * chunk_size, 0 );
+            chunk->index_storage.resize( chunk_size * chunk_size * chunk_size );
+
+            // Terrain repeats a lot of bricks, fully solid ones under the surface in particular. Store each distinct brick once.
+            brick_pool pool;
 
             uint64_t filled_count {};
 
             for ( int z = 0; z < chunk_size; z++ )
             {
+                const int brick_bottom = ( start_z * chunk_size + z ) * brick_size;
+
+                // Materials come in bands of height, so a brick has one unless a band boundary runs through it.
+                uint8_t layer_materials[brick_size];
+                bool banded = false;
+                for ( int layer = 0; layer < brick_size; layer++ )
+                {
+                    layer_materials[layer] = terrain_material( brick_bottom + layer, dims.grid_height );
+                    banded |= layer_materials[layer] != layer_materials[0];
+                }
+
                 for ( int y = 0; y < chunk_size; y++ )
                 {
                     for ( int x = 0; x < chunk_size; x++ )
                     {
-                        brick brick {};
-                        bool empty = true;
+                        // Reduce the heightmap under the brick to a fill per column, then build whole brick words from it.
+                        uint8_t fill[brick_columns];
+                        int brick_filled = 0;
+                        for ( int cell_y = 0; cell_y < brick_size; cell_y++ )
+                        {
+                            const uint16_t* row = &heights[x * brick_size + ( cell_y + y * brick_size ) * brick_size * chunk_size];
+                            for ( int cell_x = 0; cell_x < brick_size; cell_x++ )
+                            {
+                                const int column_fill = std::clamp( int( row[cell_x] ) - brick_bottom, 0, brick_size );
+                                fill[cell_x + cell_y * brick_size] = static_cast<uint8_t>( column_fill );
+                                brick_filled += column_fill;
+                            }
+                        }
+
+                        filled_count += brick_filled;
 
-                        uint32_t lod_2x2x2 = 0;
-                        for ( int cell_x = 0; cell_x < brick_size; cell_x++ )
+                        // A solid cell has a single material, full bricks across a band boundary stay bricks.
+                        if ( brick_filled == brick_size * brick_size * brick_size && !banded )
                         {
-                            for ( int cell_y = 0; cell_y < brick_size; cell_y++ )
+                            chunk->index_storage[x + y * chunk_size + z * chunk_size * chunk_size] = { brick_solid_bit, 0xFFu | uint32_t( layer_materials[0] ) << brick_material_shift };
+                        }
+                        else if ( brick_filled > 0 )
+                        {
+                            brick brick;
+                            voxelize_columns( fill, brick );
+
+                            uint32_t palette = layer_materials[0];
+                            uint32_t indices[material_index_words];
+                            bool has_indices = false;
+                            if ( banded )
                             {
-                                float height = heights[cell_x + x * brick_size + ( cell_y + y * brick_size ) * brick_size * chunk_size];
-                                for ( int cell_z = 0; cell_z < brick_size; cell_z++ )
+                                uint8_t voxel_materials[brick_size * brick_size * brick_size];
+                                for ( int layer = 0; layer < brick_size; layer++ )
                                 {
-                                    if ( ( start_z * chunk_size + z ) * brick_size + cell_z < height )
-                                    {
-                                        uint32_t sub_data = ( cell_x + cell_y * brick_size + cell_z * brick_size * brick_size ) / ( sizeof( uint32_t ) * 8 );
-                                        uint32_t bit_position = ( cell_x + cell_y * brick_size + cell_z * brick_size * brick_size ) % ( sizeof( uint32_t ) * 8 );
-                                        brick.data[sub_data] |= ( 1 << bit_position );
-                                        empty = false;
-                                        lod_2x2x2 |= 1 << ( ( ( cell_x & 0b100 ) >> 2 ) + ( ( cell_y & 0b100 ) >> 1 ) + ( cell_z & 0b100 ) );
-                                        filled_count++;
-                                    }
+                                    std::fill_n( &voxel_materials[layer * brick_columns], brick_columns, layer_materials[layer] );
                                 }
+                                has_indices = pack_brick_materials( brick, voxel_materials, colors, palette, indices );
                             }
-                        }
 
-                        if ( !empty )
-                        {
-                            chunk->bricks.push_back( brick );
-                            chunk->indices[x + y * chunk_size + z * chunk_size * chunk_size] = ( chunk->bricks.size() - 1 ) | brick_loaded_bit | ( lod_2x2x2 << 12 );
+                            chunk->index_storage[x + y * chunk_size + z * chunk_size * chunk_size] = { pool.insert( brick, palette, has_indices ? indices : nullptr ) | brick_loaded_bit,
+                                brick_lod_2x2x2( brick ) | ( palette & 0xFFu ) << brick_material_shift };
                         }
                     }
                 }
             }
 
+            store_bricks( *chunk, pool );
+
             uint32_t chunk_index = start_x + start_y * world_size.x + start_z * world_size.x * world_size.y;
             chunk->world_ptr_index = chunk_index;
             chunklist[chunk_index] = std::move( chunk );
             filled_voxel_counts[chunk_index] = filled_count;
         }
 
+        void world::store_bricks( chunk& chunk, brick_pool& pool ) const
+        {
+            chunk.material_storage = pool.take_materials();
+            chunk.material_index_storage = pool.take_material_indices();
+            std::vector<brick> bricks = pool.take_bricks();
+            chunk.brick_count = static_cast<uint32_t>( bricks.size() );
+            if ( brick_compression )
+            {
+                chunk.packed.pack( bricks );
+                chunk.brick_storage = {};
+            }
+            else
+            {
+                chunk.brick_storage = std::move( bricks );
+            }
+            chunk.use_storage();
+        }
+
         void world::generate()
         {
+            if ( !chunklist.empty() )
+            {
+                spdlog::error( "Cannot generate a world that was already generated or loaded." );
+                return;
+            }
+
             auto begin = std::chrono::steady_clock::now();
 
             spdlog::info( "Generating {}x{}x{} world of {} chunks...", world_size.x, world_size.y, world_size.z, chunk_count );
@@ -150,289 +285,2131 @@ namespace rebel_road
             chunklist.resize( chunk_count );
             filled_voxel_counts.resize( chunk_count );
 
-            const int thread_count = std::thread::hardware_concurrency();
-            std::vector<std::thread> threads( thread_count );
+            auto* job_sys = jobs::job_system_locator::get();
+            assert( job_sys );
 
-            for ( int i = 0; i < thread_count; i++ )
+            // One job per column evaluates the column's heightmap, then hands each chunk of the column to its own job.
+            jobs::task_group group;
+            for ( int y = 0; y < world_size.y; y++ )
             {
-                threads[i] = std::thread( [i, thread_count, this] ()
-                    {
-                        for ( int x = i * ( world_size.x / float( thread_count ) ); x < ( i + 1 ) * ( world_size.x / float( thread_count ) ); x++ )
+                for ( int x = 0; x < world_size.x; x++ )
+                {
+                    job_sys->submit( [this, job_sys, &group, x, y] ()
                         {
-                            for ( int y = 0; y < world_size.y; y++ )
+                            auto tile = heightmaps->get( x, y );
+                            for ( int z = 0; z < world_size.z; z++ )
                             {
-                                for ( int z = 0; z < world_size.z; z++ )
-                                {
-                                    generate_chunk( x, y, z );
-                                }
+                                job_sys->submit( [this, tile, x, y, z] () { build_chunk( *tile, x, y, z ); }, &group );
                             }
-                        }
-
-                    } );
+                        }, &group );
+                }
             }
+            job_sys->wait( group );
+
+            spdlog::info( "World generation complete [{} ms, {} heightmap tiles]", ( std::chrono::steady_clock::now() - begin ).count() / 1'000'000, heightmaps->get_stats().generated );
+
+            upload_world();
+        }
 
-            for ( auto& i : threads )
+        bool world::import_volume( const std::string& path, const glm::ivec3& raw_size )
+        {
+            if ( !chunklist.empty() )
             {
-                i.join();
+                spdlog::error( "Cannot import {} into a world that was already generated or loaded.", path );
+                return false;
             }
 
-            spdlog::info( "World generation complete [{} ms]", ( std::chrono::steady_clock::now() - begin ).count() / 1'000'000 );
+            auto begin = std::chrono::steady_clock::now();
 
-            begin = std::chrono::steady_clock::now();
-            auto worker = vulkan::worker::create( device_ctx );
+            auto volume = voxel_volume::open( path, raw_size );
+            if ( !volume )
+            {
+                return false;
+            }
 
-            std::vector<uint32_t> temp_indices( chunk_size * chunk_size * chunk_size );
+            const glm::ivec3 world_voxels = world_size * dims.chunk_size * brick_size;
+            const glm::ivec3 size = volume->get_size();
+            if ( glm::any( glm::greaterThan( size, world_voxels ) ) )
+            {
+                spdlog::warn( "Volume {} is {}x{}x{} voxels, larger than the world. It is clipped to {}x{}x{}.", path, size.x, size.y, size.z, world_voxels.x, world_voxels.y, world_voxels.z );
+            }
 
-            // For each chunk, create two buffers. One to contain all indexes for the gpu and one to contain all bricks that are currently loaded on the gpu.
+            auto built = std::chrono::steady_clock::now();
 
-            worker->immediate_submit( [&] ( vk::CommandBuffer cmd )
-                {
+            chunklist.resize( chunk_count );
+            filled_voxel_counts.resize( chunk_count );
+            colors = volume->get_colors();
 
-                    for ( int i = 0; i < chunklist.size(); i++ )
+            // Chunks only read the volume, so each is built by its own job.
+            jobs::job_system_locator::get()->parallel_for( chunk_count, 1, [&] ( uint32_t first, uint32_t last )
+                {
+                    for ( uint32_t c = first; c < last; c++ )
                     {
-                        //spdlog::info( "Upload chunk {}", i );
-                        auto& chunk = chunklist[i];
+                        import_chunk( *volume, c );
+                    }
+                } );
+
+            auto end = std::chrono::steady_clock::now();
+            const glm::ivec3 inside = glm::min( size, world_voxels );
+
+            import_stats = {};
+            import_stats.size = size;
+            import_stats.source_voxels = volume->get_source_voxels();
+            import_stats.read_ms = volume->get_read_ms();
+            import_stats.build_ms = std::chrono::duration<double, std::milli>( end - built ).count();
+            for ( uint64_t filled : filled_voxel_counts )
+            {
+                import_stats.filled_voxels += filled;
+            }
+            const double seconds = std::chrono::duration<double>( end - begin ).count();
+            import_stats.voxels_per_second = uint64_t( inside.x ) * inside.y * inside.z / std::max( seconds, 1e-9 );
+
+            spdlog::info( "Imported {} [{}x{}x{} voxels, {} filled, read {:.1f} ms, build {:.1f} ms, {:.1f} M voxels/s]", path, size.x, size.y, size.z,
+                import_stats.filled_voxels, import_stats.read_ms, import_stats.build_ms, import_stats.voxels_per_second / 1'000'000.0 );
+
+            upload_world();
+            return true;
+        }
+
+        void world::import_chunk( const voxel_volume& volume, int chunk_index )
+        {
+            const int chunk_size = dims.chunk_size;
+            const glm::ivec3 chunk_pos( chunk_index % world_size.x, ( chunk_index / world_size.x ) % world_size.y, chunk_index / ( world_size.x * world_size.y ) );
+            const glm::ivec3 chunk_origin = chunk_pos * chunk_size * brick_size;
+
+            auto chunk = std::make_unique<voxel::chunk>();
+            chunk->index_storage.resize( chunk_size * chunk_size * chunk_size );
 
-                        filled_voxels += filled_voxel_counts[i];
+            brick_pool pool;
+            uint64_t filled_count {};
 
-                        // Optimize me: this is very slow.
-                        for ( int j = 0; j < chunk->indices.size(); j++ )
+            // Chunks outside the volume stay empty.
+            if ( glm::all( glm::lessThan( chunk_origin, volume.get_size() ) ) )
+            {
+                for ( int z = 0; z < chunk_size; z++ )
+                {
+                    for ( int y = 0; y < chunk_size; y++ )
+                    {
+                        for ( int x = 0; x < chunk_size; x++ )
                         {
-                            if ( chunk->indices[j] & brick_loaded_bit )
+                            brick brick {};
+                            if ( !volume.brick_mask( chunk_origin + glm::ivec3( x, y, z ) * brick_size, brick ) )
+                            {
+                                continue;
+                            }
+
+                            const uint32_t count = brick_voxel_count( brick );
+                            filled_count += count;
+                            if ( count == 0 )
                             {
-                                // For each brick that has been created, mark it as unloaded (on the gpu) and save the lod bits.
-                                temp_indices[j] = brick_unloaded_bit | ( chunk->indices[j] & brick_lod_bits );
+                                continue;
+                            }
+
+                            uint8_t voxel_materials[brick_size * brick_size * brick_size];
+                            volume.brick_materials( chunk_origin + glm::ivec3( x, y, z ) * brick_size, voxel_materials );
+                            uint32_t palette {};
+                            uint32_t indices[material_index_words];
+                            const bool has_indices = pack_brick_materials( brick, voxel_materials, colors, palette, indices );
+
+                            // Only a brick of one material can become a solid cell.
+                            cell_index& index = chunk->index_storage[x + y * chunk_size + z * chunk_size * chunk_size];
+                            const uint32_t material_bits = ( palette & 0xFFu ) << brick_material_shift;
+                            if ( count == brick_size * brick_size * brick_size && !has_indices )
+                            {
+                                index = { brick_solid_bit, 0xFFu | material_bits };
                             }
                             else
                             {
-                                temp_indices[j] = 0;
+                                index = { pool.insert( brick, palette, has_indices ? indices : nullptr ) | brick_loaded_bit, brick_lod_2x2x2( brick ) | material_bits };
                             }
                         }
+                    }
+                }
+            }
 
-                        // Upload the chunk's brick indices to the GPU and note the device address of the index buffer.
+            store_bricks( *chunk, pool );
 
-                        vulkan::buffer<uint32_t> index_staging;
-                        index_staging.allocate( chunk->indices.size() * sizeof( uint32_t ), vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_ONLY );
-                        index_staging.upload_to_buffer( temp_indices.data(), temp_indices.size() * sizeof( uint32_t ) );
+            chunk->world_ptr_index = chunk_index;
+            chunklist[chunk_index] = std::move( chunk );
+            filled_voxel_counts[chunk_index] = filled_count;
+        }
 
-                        chunk->gpu_indices.allocate( chunk->indices.size() * sizeof( uint32_t ), vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY );
-                        chunk->gpu_index_address = vulkan::get_buffer_device_address( chunk->gpu_indices.buf );
-                        world_index_ptrs.index_buf_pointers[i] = chunk->gpu_index_address;
+        void world::regenerate_region( const glm::ivec3& min_chunk, const glm::ivec3& max_chunk )
+        {
+            if ( pager || chunklist.empty() )
+            {
+                spdlog::error( "Cannot regenerate a region of a paged or empty world." );
+                return;
+            }
 
-                        vk::BufferCopy copy {};
-                        copy.size = index_staging.size;
-                        cmd.copyBuffer( index_staging.buf, chunk->gpu_indices.buf, 1, &copy );
+            auto begin = std::chrono::steady_clock::now();
+            const auto tiles_before = heightmaps->get_stats().generated;
 
-                        brick_loader_deletion_queue.push_function( [index_staging] () mutable { index_staging.free(); } );
+            const glm::ivec3 low = glm::max( min_chunk, glm::ivec3( 0 ) );
+            const glm::ivec3 high = glm::min( max_chunk, world_size - 1 );
+            if ( glm::any( glm::greaterThan( low, high ) ) )
+            {
+                return;
+            }
 
-                        // Each time the capacity of gpu_bricks would be exceeded, we will reallocate it at double size in process_load_queue.
-                        // We don't start with any bricks loaded on the GPU. When rays hit an unloaded brick they will request a load.
+            // The region's GPU buffers may still be in use by frames in flight. The streaming thread has to service them before the GPU can go idle.
+            stop_streaming();
+            device_ctx->device.waitIdle();
+            // Nothing is in flight any more.
+            release_retired_slots( UINT64_MAX );
+
+            for ( int z = low.z; z <= high.z; z++ )
+            {
+                for ( int y = low.y; y <= high.y; y++ )
+                {
+                    for ( int x = low.x; x <= high.x; x++ )
+                    {
+                        const int chunk_index = x + y * world_size.x + z * world_size.x * world_size.y;
+                        account_chunk( chunk_index, -1 );
+                        release_chunk_bricks( *chunklist[chunk_index] );
+                    }
+                }
+            }
 
-                        chunk->gpu_bricks.allocate( chunk_brick_buffer_starting_size * sizeof( brick ), vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY );
-                        chunk->gpu_brick_address = vulkan::get_buffer_device_address( chunk->gpu_bricks.buf );
-                        world_brick_ptrs.brick_buf_pointers[i] = chunk->gpu_brick_address;
+            const glm::ivec3 extent = high - low + 1;
+            jobs::job_system_locator::get()->parallel_for( extent.x * extent.y, 1, [&] ( uint32_t begin, uint32_t end )
+                {
+                    for ( uint32_t column = begin; column < end; column++ )
+                    {
+                        generate_column( low.x + column % extent.x, low.y + column / extent.x, low.z, high.z );
                     }
                 } );
 
+            // The region's chunks are uploaded whole with their new distances, cells around it only need their distance.
+            const glm::ivec3 low_cell = low * dims.chunk_size;
+            const glm::ivec3 high_cell = ( high + 1 ) * dims.chunk_size - 1;
+            std::vector<uint32_t> moved;
+            cell_distances.update( low_cell.x, low_cell.y, low_cell.z, high_cell.x, high_cell.y, high_cell.z, [this] ( int x, int y, int z ) { return is_cell_occupied( x, y, z ); }, moved );
+            const int cells_xy = dims.get_cells();
+            std::erase_if( moved, [&] ( uint32_t cell )
+                {
+                    const glm::ivec3 pos( cell % cells_xy, ( cell / cells_xy ) % cells_xy, cell / ( cells_xy * cells_xy ) );
+                    return glm::all( glm::greaterThanEqual( pos, low_cell ) ) && glm::all( glm::lessThanEqual( pos, high_cell ) );
+                } );
+
             worker->immediate_submit( [&] ( vk::CommandBuffer cmd )
                 {
-                    // Upload world data, indices, and bricks to the GPU.
-                    auto staging1 = gpu_world_conf.upload_to_buffer( cmd, &world_conf, sizeof( world_conf ) );
-                    brick_loader_deletion_queue.push_function( [staging1] () mutable { staging1.free(); } );
+                    upload_cell_distances( cmd, moved );
+
+                    for ( int z = low.z; z <= high.z; z++ )
+                    {
+                        for ( int y = low.y; y <= high.y; y++ )
+                        {
+                            for ( int x = low.x; x <= high.x; x++ )
+                            {
+                                const int chunk_index = x + y * world_size.x + z * world_size.x * world_size.y;
+                                account_chunk( chunk_index, 1 );
+                                upload_chunk( cmd, chunk_index );
 
-                    auto staging2 = gpu_world_index_ptrs.upload_to_buffer( cmd, &world_index_ptrs, sizeof( world_index_ptrs ) );
-                    brick_loader_deletion_queue.push_function( [staging2] () mutable { staging2.free(); } );
+                                const uint32_t bit = 1u << ( chunk_index % 32 );
+                                chunk_occupancy[chunk_index / 32] = chunklist[chunk_index]->has_cells() ? chunk_occupancy[chunk_index / 32] | bit : chunk_occupancy[chunk_index / 32] & ~bit;
+                            }
+                        }
+                    }
 
-                    auto staging3 = gpu_world_brick_ptrs.upload_to_buffer( cmd, &world_brick_ptrs, sizeof( world_brick_ptrs ) );
-                    brick_loader_deletion_queue.push_function( [staging3] () mutable { staging3.free(); } );
+                    auto staging = gpu_chunk_occupancy.upload_to_buffer( cmd, chunk_occupancy.data(), chunk_occupancy.size() * sizeof( uint32_t ) );
+                    brick_loader_deletion_queue.push_function( [staging] () mutable { staging.free(); } );
                 } );
 
-            // Upload pointer data to GPU.
-
-            // Create a descriptor set for copying uploaded brick data into position on the GPU.
-            vulkan::descriptor_builder::begin( render_ctx->get_descriptor_layout_cache(), render_ctx->get_descriptor_allocator() )
-                .bind_buffer( 0, gpu_bricks_to_load.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
-                .bind_buffer( 1, gpu_indices_to_load.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
-                .bind_buffer( 2, bricks_requested_by_gpu.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
-                .bind_buffer( 3, gpu_world_index_ptrs.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
-                .bind_buffer( 4, gpu_world_brick_ptrs.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
-                .bind_buffer( 5, gpu_world_conf.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
-                .build( upload_set );
+            start_streaming();
 
-            spdlog::info( "Allocation took {} ms", ( std::chrono::steady_clock::now() - begin ).count() / 1'000'000 );
+            spdlog::info( "Regenerated {} chunks [{} ms, {} new heightmap tiles]", extent.x * extent.y * extent.z,
+                ( std::chrono::steady_clock::now() - begin ).count() / 1'000'000, heightmaps->get_stats().generated - tiles_before );
         }
 
-        void world::tick( float delta_time )
+        placement_benchmark_result world::benchmark_placement( uint32_t ticks )
         {
-            ZoneScopedN( "world - tick" );
+            ZoneScopedN( "world - benchmark placement" );
 
-            load_requested_bricks();
-            process_load_queue();
-            world_frame++;
-        }
+            placement_benchmark_result result;
+            if ( !device_ctx->gpu_props.limits.timestampComputeAndGraphics )
+            {
+                spdlog::warn( "Placement benchmark: the GPU has no timestamps on the graphics queue." );
+                return result;
+            }
 
-        void world::load_requested_bricks()
-        {
-            ZoneScopedN( "world - load bricks" );
+            // Fill a request queue with cells of the first chunks in order, each getting its own brick and heap slot.
+            const uint32_t cells_per_chunk = dims.chunk_size * dims.chunk_size * dims.chunk_size;
+            const uint32_t count = static_cast<uint32_t>( std::min<uint64_t>( brick_load_queue_size, uint64_t( cells_per_chunk ) * chunk_count ) );
+            const uint32_t chunks_used = ( count + cells_per_chunk - 1 ) / cells_per_chunk;
+
+            auto requests = std::make_unique<gpu_brick_load_queue>();
+            std::vector<brick> bricks( count );
+            std::vector<uint32_t> palette_entries;
+            std::vector<uint32_t> payload_words;
+            std::vector<gpu_brick_placement> placements( count );
+            for ( uint32_t i = 0; i < count; i++ )
+            {
+                const uint32_t chunk_index = i / cells_per_chunk;
+                const uint32_t cell = i % cells_per_chunk;
+                const glm::ivec3 chunk_pos( chunk_index % world_size.x, ( chunk_index / world_size.x ) % world_size.y, chunk_index / ( world_size.x * world_size.y ) );
+                const glm::ivec3 cell_pos( cell % dims.chunk_size, ( cell / dims.chunk_size ) % dims.chunk_size, cell / ( dims.chunk_size * dims.chunk_size ) );
+                requests->bricks_to_load[i] = glm::ivec4( chunk_pos * dims.chunk_size + cell_pos, 1 );
+
+                // Surface like bricks, full below a layer and empty above it, so every kind of encoded word is decoded.
+                const int surface = i % brick_size;
+                for ( int w = 0; w < cell_members; w++ )
+                {
+                    const int layer = w / 2;
+                    bricks[i].data[w] = layer < surface ? 0xFFFFFFFFu
+                        : layer == surface ? i * 2654435761u + w
+                        : layer == surface + 1 ? bricks[i].data[w - 2]
+                        : 0;
+                }
+
+                // Every other brick has more than one material, so half the placements also copy palette entries.
+                const uint32_t material_block = i % 2 ? i / 2 + 1 : 0;
+                uint32_t encoded[brick_codec_max_words];
+                placements[i] = { i | brick_loaded_bit, static_cast<uint32_t>( payload_words.size() ), i, material_block };
+                payload_words.insert( payload_words.end(), encoded, encoded + encode_brick( bricks[i], encoded ) );
+                if ( material_block != 0 )
+                {
+                    for ( int w = 0; w < material_index_words; w++ )
+                    {
+                        palette_entries.push_back( i * 40503u + w );
+                    }
+                    payload_words.insert( payload_words.end(), palette_entries.end() - material_index_words, palette_entries.end() );
+                }
+            }
+            requests->load_queue_count = count;
+            requests->request_capacity = count;
+
+            // Scratch buffers laid out like the world's, so neither the world on the GPU nor the streaming thread is disturbed.
+            const vk::DeviceSize chunk_bytes = get_chunk_index_bytes();
+            vulkan::buffer<uint32_t> scratch_payloads;
+            vulkan::buffer<gpu_brick_placement> scratch_placements;
+            vulkan::buffer<gpu_brick_load_queue> scratch_requests;
+            vulkan::buffer<cell_index> scratch_indices;
+            vulkan::buffer<uint64_t> scratch_index_ptrs;
+            vulkan::buffer<brick> scratch_heap;
+            vulkan::buffer<uint64_t> scratch_occupancy;
+            vulkan::buffer<gpu_brick_material> scratch_materials;
+            vulkan::buffer<uint32_t> scratch_material_indices;
+            scratch_payloads.allocate( payload_words.size() * sizeof( uint32_t ), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_ONLY );
+            scratch_placements.allocate( count * sizeof( gpu_brick_placement ), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_ONLY );
+            scratch_requests.allocate( sizeof( gpu_brick_load_queue ), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_ONLY );
+            // The placement targets are device memory like the world's, so the timing is the one streaming gets. They are copied back for the check afterwards.
+            const vk::BufferUsageFlags target_usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc;
+            scratch_indices.allocate( chunks_used * chunk_bytes, target_usage | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eShaderDeviceAddress, VMA_MEMORY_USAGE_GPU_ONLY );
+            scratch_index_ptrs.allocate( chunk_count * sizeof( uint64_t ), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_ONLY );
+            scratch_heap.allocate( count * sizeof( brick ), target_usage, VMA_MEMORY_USAGE_GPU_ONLY );
+            scratch_occupancy.allocate( count * sizeof( uint64_t ), target_usage, VMA_MEMORY_USAGE_GPU_ONLY );
+            scratch_materials.allocate( count * sizeof( gpu_brick_material ), target_usage, VMA_MEMORY_USAGE_GPU_ONLY );
+            scratch_material_indices.allocate( std::max<size_t>( palette_entries.size(), 1 ) * sizeof( uint32_t ), target_usage, VMA_MEMORY_USAGE_GPU_ONLY );
+
+            // One readback buffer holds every target, each at its own offset.
+            const vk::DeviceSize indices_offset = 0;
+            const vk::DeviceSize heap_offset = indices_offset + scratch_indices.size;
+            const vk::DeviceSize occupancy_offset = heap_offset + scratch_heap.size;
+            const vk::DeviceSize materials_offset = occupancy_offset + scratch_occupancy.size;
+            const vk::DeviceSize material_indices_offset = materials_offset + scratch_materials.size;
+            vulkan::buffer<std::byte> readback;
+            readback.allocate( material_indices_offset + scratch_material_indices.size, vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU );
+
+            const vk::DeviceAddress indices_address = vulkan::get_buffer_device_address( scratch_indices.buf );
+            std::vector<uint64_t> index_ptrs( chunk_count, 0 );
+            for ( uint32_t c = 0; c < chunks_used; c++ )
+            {
+                index_ptrs[c] = indices_address + c * chunk_bytes;
+            }
 
-            const uint64_t no_wait = 0;
+            vk::DescriptorSet scratch_set;
+            vulkan::descriptor_builder::begin( render_ctx->get_descriptor_layout_cache(), render_ctx->get_descriptor_allocator() )
+                .bind_buffer( 0, scratch_payloads.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 1, scratch_placements.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 2, scratch_requests.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 3, scratch_index_ptrs.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 4, scratch_heap.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 5, gpu_world_conf.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 6, scratch_occupancy.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 7, scratch_materials.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 8, scratch_material_indices.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .build( scratch_set );
 
-            // Wait for main thread's device work to complete.
-            std::vector<vk::Semaphore> wait_semaphores = { brick_halt_semaphore };
-            std::vector<uint64_t> wait_values = { world_frame };
+            vk::QueryPoolCreateInfo query_info {};
+            query_info.queryType = vk::QueryType::eTimestamp;
+            query_info.queryCount = 2;
+            vk::QueryPool query_pool = device_ctx->device.createQueryPool( query_info );
 
-            vk::SemaphoreWaitInfo wait_info;
-            wait_info.semaphoreCount = wait_semaphores.size();
-            wait_info.pSemaphores = wait_semaphores.data();
-            wait_info.pValues = wait_values.data();
-            VK_CHECK( device_ctx->device.waitSemaphores( &wait_info, UINT64_MAX ) );
+            util::deletion_queue staging;
+            worker->immediate_submit( [&] ( vk::CommandBuffer cmd )
+                {
+                    auto staging_bricks = scratch_payloads.upload_to_buffer( cmd, payload_words.data(), payload_words.size() * sizeof( uint32_t ) );
+                    auto staging_placements = scratch_placements.upload_to_buffer( cmd, placements.data(), placements.size() * sizeof( gpu_brick_placement ) );
+                    auto staging_requests = scratch_requests.upload_to_buffer( cmd, requests.get(), sizeof( gpu_brick_load_queue ) );
+                    auto staging_ptrs = scratch_index_ptrs.upload_to_buffer( cmd, index_ptrs.data(), index_ptrs.size() * sizeof( uint64_t ) );
+                    staging.push_function( [=] () mutable { staging_bricks.free(); staging_placements.free(); staging_requests.free(); staging_ptrs.free(); } );
+                    cmd.fillBuffer( scratch_indices.buf, 0, VK_WHOLE_SIZE, 0 );
+
+                    vk::MemoryBarrier uploads_complete { vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite };
+                    cmd.pipelineBarrier( vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, 1, &uploads_complete, 0, nullptr, 0, nullptr );
+
+                    cmd.resetQueryPool( query_pool, 0, 2 );
+                    cmd.writeTimestamp( vk::PipelineStageFlagBits::eTopOfPipe, query_pool, 0 );
+
+                    // Each tick places the same bricks again, as process_load_queue would with a full queue.
+                    const gpu_placement_constants constants { 0, count };
+                    cmd.bindPipeline( vk::PipelineBindPoint::eCompute, upload_bricks_pipeline );
+                    cmd.bindDescriptorSets( vk::PipelineBindPoint::eCompute, upload_bricks_layout, 0, 1, &scratch_set, 0, nullptr );
+                    cmd.pushConstants( upload_bricks_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof( constants ), &constants );
+                    for ( uint32_t t = 0; t < ticks; t++ )
+                    {
+                        cmd.dispatch( ( count * cell_members + brick_placement_group_size - 1 ) / brick_placement_group_size, 1, 1 );
+                        cmd.pipelineBarrier( vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, 0, nullptr, 0, nullptr, 0, nullptr );
+                    }
 
-            loader_frames++;
-            uint64_t signal_value = loader_frames;
+                    cmd.writeTimestamp( vk::PipelineStageFlagBits::eBottomOfPipe, query_pool, 1 );
 
-            stat_brick_loads = 0;
+                    vk::MemoryBarrier placement_complete { vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead };
+                    cmd.pipelineBarrier( vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, {}, 1, &placement_complete, 0, nullptr, 0, nullptr );
 
-            // Check to see if any bricks have been requested.
-            gpu_brick_load_queue* requested_bricks = bricks_requested_by_gpu.mapped_data();
-            uint32_t brick_to_load_count = std::min( static_cast<uint32_t>( brick_load_queue_size ), requested_bricks->load_queue_count );
-            if ( brick_to_load_count > 0 )
+                    auto copy_back = [&] ( vk::Buffer source, vk::DeviceSize size, vk::DeviceSize offset )
+                    {
+                        vk::BufferCopy copy { 0, offset, size };
+                        cmd.copyBuffer( source, readback.buf, 1, &copy );
+                    };
+                    copy_back( scratch_indices.buf, scratch_indices.size, indices_offset );
+                    copy_back( scratch_heap.buf, scratch_heap.size, heap_offset );
+                    copy_back( scratch_occupancy.buf, scratch_occupancy.size, occupancy_offset );
+                    copy_back( scratch_materials.buf, scratch_materials.size, materials_offset );
+                    copy_back( scratch_material_indices.buf, scratch_material_indices.size, material_indices_offset );
+
+                    auto readback_complete = readback.get_memory_barrier( vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead );
+                    cmd.pipelineBarrier( vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, {}, 0, nullptr, 1, &readback_complete, 0, nullptr );
+                } );
+            staging.flush();
+
+            uint64_t timestamps[2] {};
+            VK_CHECK( device_ctx->device.getQueryPoolResults( query_pool, 0, 2, sizeof( timestamps ), timestamps, sizeof( uint64_t ), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait ) );
+            device_ctx->device.destroyQueryPool( query_pool );
+
+            result.bricks_per_tick = count;
+            result.ticks = ticks;
+            result.gpu_ms = ( timestamps[1] - timestamps[0] ) * double( device_ctx->gpu_props.limits.timestampPeriod ) / 1'000'000.0;
+            result.bricks_per_second = result.gpu_ms > 0 ? uint64_t( count ) * ticks / ( result.gpu_ms / 1000.0 ) : 0.0;
+            result.payload_bytes_per_brick = payload_words.size() * sizeof( uint32_t ) / double( count );
+
+            result.verified = true;
+            vmaInvalidateAllocation( device_ctx->allocator, readback.allocation, 0, VK_WHOLE_SIZE );
+            const std::byte* read = readback.mapped_data();
+            const brick* placed = reinterpret_cast<const brick*>( read + heap_offset );
+            const cell_index* indices = reinterpret_cast<const cell_index*>( read + indices_offset );
+            const uint64_t* occupancy = reinterpret_cast<const uint64_t*>( read + occupancy_offset );
+            const gpu_brick_material* materials = reinterpret_cast<const gpu_brick_material*>( read + materials_offset );
+            const uint32_t* material_indices = reinterpret_cast<const uint32_t*>( read + material_indices_offset );
+            for ( uint32_t i = 0; i < count && result.verified; i++ )
             {
-                stat_brick_loads = brick_to_load_count;
+                const uint32_t cell = ( i / cells_per_chunk ) * ( chunk_bytes / sizeof( cell_index ) ) + i % cells_per_chunk;
+                const uint32_t material_block = placements[i].material_block;
+                result.verified = std::memcmp( &placed[i], &bricks[i], sizeof( brick ) ) == 0 && indices[cell].bits == ( i | brick_loaded_bit )
+                    && occupancy[i] == brick_occupancy_4x4x4( bricks[i] ) && materials[i].palette == i && materials[i].block == material_block
+                    && ( material_block == 0 || std::memcmp( &material_indices[( material_block - 1 ) * material_index_words], &palette_entries[( material_block - 1 ) * material_index_words], material_index_words * sizeof( uint32_t ) ) == 0 );
+                if ( !result.verified )
+                {
+                    spdlog::error( "Placement benchmark: brick {} was not placed correctly.", i );
+                }
+            }
 
-                oubound_bricks = 0;
+            scratch_payloads.free();
+            scratch_placements.free();
+            scratch_requests.free();
+            scratch_indices.free();
+            scratch_index_ptrs.free();
+            scratch_heap.free();
+            scratch_occupancy.free();
+            scratch_materials.free();
+            scratch_material_indices.free();
+            readback.free();
+
+            spdlog::info( "Placement benchmark, {} bricks x {} ticks: {:.3f} ms on the GPU, {:.2f} us per tick, {:.1f} M bricks/s, {:.1f} payload bytes per brick",
+                count, ticks, result.gpu_ms, result.gpu_ms * 1000.0 / std::max( ticks, 1u ), result.bricks_per_second / 1'000'000.0, result.payload_bytes_per_brick );
+            return result;
+        }
 
-                brick_loader_cmd.reset( {} );
-                vk::CommandBufferBeginInfo begin_info {};
-                brick_loader_cmd.begin( begin_info );
+        brick_codec_benchmark_result world::benchmark_brick_codec( uint32_t max_bricks )
+        {
+            // Edits on the streaming thread repack chunks and move their bricks, so it waits until the copy is taken.
+            const bool streaming = streaming_thread.joinable();
+            stop_streaming();
 
-                // Write the requested bricks to the host->GPU buffers.
-                std::vector<brick> bricks_to_load;
-                std::vector<uint32_t> indices_to_load;
-                for ( int i = 0; i < brick_to_load_count; i++ )
+            // The world's own bricks, so the ratio is the one its terrain gets. Chunks paged out have none on the host.
+            std::vector<brick> bricks;
+            for ( const auto& chunk : chunklist )
+            {
+                const uint32_t stored = chunk->packed.empty() ? static_cast<uint32_t>( chunk->bricks.size() ) : chunk->packed.size();
+                for ( uint32_t i = 0; i < stored && bricks.size() < max_bricks; i++ )
                 {
-                    const glm::ivec3& pos = requested_bricks->bricks_to_load[i];
+                    chunk->get_brick( i, bricks.emplace_back() );
+                }
+            }
 
-                    // Determine the chunk this brick resides in.
-                    const auto chunk_index = get_chunk_index( pos );
-                    const auto& chunk = chunklist[chunk_index];
-                    const glm::ivec3 brick_pos = pos % chunk_size;
+            if ( streaming )
+            {
+                start_streaming();
+            }
 
-                    // Look up the index for the brick within the chunk.
-                    const uint32_t index_of_index = brick_pos.x + brick_pos.y * chunk_size + brick_pos.z * chunk_size * chunk_size;
-                    const uint32_t index = chunk->indices[index_of_index];
+            return voxel::benchmark_brick_codec( bricks );
+        }
 
-                    // Fetch the brick and calculate a new index.
-                    auto brick = chunk->bricks[index & brick_index_bits];
-                    auto new_index = ( chunk->gpu_index_highest | brick_loaded_bit | ( index & brick_lod_bits ) );
+        bool world::save( const std::string& path )
+        {
+            // Edits on the streaming thread repack chunks and move their bricks, so it waits until the file is written.
+            const bool streaming = streaming_thread.joinable();
+            stop_streaming();
 
-                    // Place data for GPU upload.
-                    bricks_to_load.push_back( brick );
-                    indices_to_load.push_back( new_index );
+            const bool saved = write_world_file( path );
 
-                    chunk->gpu_index_highest++;
+            if ( streaming )
+            {
+                start_streaming();
+            }
+            return saved;
+        }
 
-                    oubound_bricks++;
-                }
+        bool world::write_world_file( const std::string& path ) const
+        {
+            if ( pager )
+            {
+                spdlog::error( "Cannot save a paged world, its bricks are not resident." );
+                return false;
+            }
 
-                auto staging_bricks = gpu_bricks_to_load.upload_to_buffer( brick_loader_cmd, bricks_to_load.data(), bricks_to_load.size() * sizeof( brick ) );
-                brick_loader_deletion_queue.push_function( [staging_bricks] () mutable { staging_bricks.free(); } );
+            auto begin = std::chrono::steady_clock::now();
 
-                auto staging_indices = gpu_indices_to_load.upload_to_buffer( brick_loader_cmd, indices_to_load.data(), indices_to_load.size() * sizeof( uint32_t ) );
-                brick_loader_deletion_queue.push_function( [staging_indices] () mutable { staging_indices.free(); } );
+            std::ofstream file( path, std::ios::binary | std::ios::trunc );
+            if ( !file )
+            {
+                spdlog::error( "Unable to open world file {} for writing.", path );
+                return false;
+            }
 
-                brick_loader_cmd.end();
+            world_file_header header {};
+            header.grid_size = dims.grid_size;
+            header.grid_height = dims.grid_height;
+            header.chunk_size = dims.chunk_size;
+            header.brick_size = brick_size;
+            header.chunk_count = static_cast<uint32_t>( chunklist.size() );
+            header.material_colors_offset = sizeof( world_file_header );
+            header.chunk_table_offset = header.material_colors_offset + sizeof( material_colors );
+
+            // Lay out the chunk table first so every array offset is known before anything is written.
+            std::vector<world_file_chunk> table( chunklist.size() );
+            uint64_t offset = world_file_align( header.chunk_table_offset + table.size() * sizeof( world_file_chunk ) );
+            for ( int i = 0; i < chunklist.size(); i++ )
+            {
+                const auto& chunk = chunklist[i];
+
+                table[i].index_count = static_cast<uint32_t>( chunk->indices.size() );
+                table[i].brick_count = chunk->brick_count;
+                table[i].filled_voxels = filled_voxel_counts[i];
+                header.filled_voxels += filled_voxel_counts[i];
+
+                table[i].index_offset = offset;
+                offset = world_file_align( offset + chunk->indices.size_bytes() );
+                table[i].brick_offset = offset;
+                offset = world_file_align( offset + uint64_t( chunk->brick_count ) * sizeof( brick ) );
+                table[i].material_offset = offset;
+                offset = world_file_align( offset + chunk->materials.size_bytes() );
+                table[i].material_index_offset = offset;
+                table[i].material_index_count = static_cast<uint32_t>( chunk->material_indices.size() );
+                offset = world_file_align( offset + chunk->material_indices.size_bytes() );
+            }
 
-                vk::TimelineSemaphoreSubmitInfo timeline_info;
-                timeline_info.waitSemaphoreValueCount = 1;
-                timeline_info.pWaitSemaphoreValues = &no_wait;
-                timeline_info.signalSemaphoreValueCount = 1;
-                timeline_info.pSignalSemaphoreValues = &signal_value;
-                auto submit_info = vulkan::submit_info( &brick_loader_cmd );
+            const std::vector<char> padding( world_file_alignment, 0 );
+            auto pad_to = [&] ( uint64_t target )
+            {
+                const uint64_t position = static_cast<uint64_t>( file.tellp() );
+                file.write( padding.data(), target - position );
+            };
 
-                vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eTransfer;
+            file.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+            file.write( reinterpret_cast<const char*>( colors.data() ), sizeof( material_colors ) );
+            file.write( reinterpret_cast<const char*>( table.data() ), table.size() * sizeof( world_file_chunk ) );
 
-                submit_info.pNext = &timeline_info;
-                submit_info.pWaitDstStageMask = &wait_stage;
-                submit_info.signalSemaphoreCount = 1;
-                submit_info.pSignalSemaphores = &brick_load_semaphore;
+            for ( int i = 0; i < chunklist.size(); i++ )
+            {
+                const auto& chunk = chunklist[i];
 
-                VK_CHECK( render_ctx->get_transfer_queue().submit( 1, &submit_info, nullptr ) );
+                pad_to( table[i].index_offset );
+                file.write( reinterpret_cast<const char*>( chunk->indices.data() ), chunk->indices.size_bytes() );
+                pad_to( table[i].brick_offset );
+                if ( chunk->packed.empty() )
+                {
+                    file.write( reinterpret_cast<const char*>( chunk->bricks.data() ), chunk->bricks.size_bytes() );
+                }
+                else
+                {
+                    // The file holds bricks as they are in memory uncompressed, so it can be mapped.
+                    const std::vector<brick> bricks = chunk->packed.unpack_all();
+                    file.write( reinterpret_cast<const char*>( bricks.data() ), bricks.size() * sizeof( brick ) );
+                }
+                pad_to( table[i].material_offset );
+                file.write( reinterpret_cast<const char*>( chunk->materials.data() ), chunk->materials.size_bytes() );
+                pad_to( table[i].material_index_offset );
+                file.write( reinterpret_cast<const char*>( chunk->material_indices.data() ), chunk->material_indices.size_bytes() );
             }
-            else
-            {
-                vk::SemaphoreSignalInfo signal_info {};
-                signal_info.semaphore = brick_load_semaphore;
-                signal_info.value = signal_value;
+            pad_to( offset );
 
-                VK_CHECK( device_ctx->device.signalSemaphore( &signal_info ) );
+            if ( !file )
+            {
+                spdlog::error( "Failed writing world file {}.", path );
+                return false;
             }
+
+            spdlog::info( "Saved world to {} [{} MB, {} ms]", path, offset / ( 1024 * 1024 ), ( std::chrono::steady_clock::now() - begin ).count() / 1'000'000 );
+            return true;
         }
 
-        void world::process_load_queue()
+        bool world::load( const std::string& path, uint64_t paging_budget )
         {
-            ZoneScopedN( "world - process load queue" );
+            // The streaming thread, the index heap and the statistics all assume the chunks never change underneath them.
+            if ( !chunklist.empty() )
+            {
+                spdlog::error( "Cannot load {} into a world that was already generated or loaded.", path );
+                return false;
+            }
 
-            std::vector<vk::Semaphore> wait_semaphores = { brick_load_semaphore };
-            std::vector<uint64_t> wait_values = { loader_frames };
+            auto begin = std::chrono::steady_clock::now();
 
-            vk::SemaphoreWaitInfo wait_info;
-            wait_info.semaphoreCount = wait_semaphores.size();
-            wait_info.pSemaphores = wait_semaphores.data();
-            wait_info.pValues = wait_values.data();
-            VK_CHECK( device_ctx->device.waitSemaphores( &wait_info, UINT64_MAX ) );
+            auto file = io::mapped_file::create( path );
+            if ( !file->is_open() )
+            {
+                spdlog::info( "No world file at {}.", path );
+                return false;
+            }
 
-            brick_loader_deletion_queue.flush();
+            const auto* header = file->at<world_file_header>( 0 );
+            if ( !header || header->magic != world_file_magic )
+            {
+                spdlog::error( "{} is not a world file.", path );
+                return false;
+            }
 
-            proc_frames++;
-            uint64_t signal_value = proc_frames;
+            if ( header->version != world_file_version )
+            {
+                spdlog::warn( "World file {} has version {}, expected {}.", path, header->version, world_file_version );
+                return false;
+            }
+
+            if ( header->grid_size != dims.grid_size || header->grid_height != dims.grid_height || header->chunk_size != dims.chunk_size || header->brick_size != brick_size || header->chunk_count != chunk_count )
+            {
+                spdlog::warn( "World file {} dimensions do not match this world.", path );
+                return false;
+            }
+
+            const auto* table = file->at<world_file_chunk>( header->chunk_table_offset, header->chunk_count );
+            const auto* file_colors = file->at<material_colors>( header->material_colors_offset );
+            if ( !table || !file_colors )
+            {
+                spdlog::error( "World file {} is truncated.", path );
+                return false;
+            }
+
+            std::vector<std::unique_ptr<chunk>> loaded_chunks( chunk_count );
+            std::vector<uint64_t> loaded_voxel_counts( chunk_count );
+
+            for ( int i = 0; i < chunk_count; i++ )
+            {
+                cell_index* indices = file->at<cell_index>( table[i].index_offset, table[i].index_count );
+                brick* bricks = file->at<brick>( table[i].brick_offset, table[i].brick_count );
+                brick_material* materials = file->at<brick_material>( table[i].material_offset, table[i].brick_count );
+                uint32_t* material_indices = file->at<uint32_t>( table[i].material_index_offset, table[i].material_index_count );
+                bool valid = indices && ( bricks || table[i].brick_count == 0 ) && table[i].index_count == dims.chunk_size * dims.chunk_size * dims.chunk_size
+                    && ( materials || table[i].brick_count == 0 ) && ( material_indices || table[i].material_index_count == 0 );
+
+                // Cells and materials index into the rest of the entry, which the streaming thread and the GPU read without checking.
+                for ( uint32_t j = 0; valid && j < table[i].index_count; j++ )
+                {
+                    const uint32_t bits = indices[j].bits;
+                    valid = !( bits & ( brick_loaded_bit | brick_unloaded_bit ) ) || ( bits & brick_index_bits ) < table[i].brick_count;
+                }
+                for ( uint32_t j = 0; valid && j < table[i].brick_count; j++ )
+                {
+                    const uint32_t first = materials[j].indices;
+                    valid = first == brick_uniform_material || uint64_t( first ) + material_index_words <= table[i].material_index_count;
+                }
+
+                if ( !valid )
+                {
+                    spdlog::error( "World file {} has a corrupt entry for chunk {}.", path, i );
+                    return false;
+                }
+
+                auto chunk = std::make_unique<voxel::chunk>();
+                chunk->indices = std::span<cell_index>( indices, table[i].index_count );
+                if ( paging_budget == 0 )
+                {
+                    chunk->bricks = std::span<brick>( bricks, table[i].brick_count );
+                }
+                // Materials stay mapped while the bricks are paged, the streaming thread needs them to place any brick.
+                chunk->materials = std::span<brick_material>( materials, table[i].brick_count );
+                chunk->material_indices = std::span<uint32_t>( material_indices, table[i].material_index_count );
+                chunk->brick_count = table[i].brick_count;
+                chunk->world_ptr_index = i;
+
+                loaded_chunks[i] = std::move( chunk );
+                loaded_voxel_counts[i] = table[i].filled_voxels;
+            }
+
+            // The pager opens the file for itself. Failing here leaves the world as it was.
+            std::unique_ptr<chunk_pager> loaded_pager;
+            if ( paging_budget > 0 )
+            {
+                loaded_pager = chunk_pager::create( path, std::vector<world_file_chunk>( table, table + header->chunk_count ), paging_budget );
+                if ( !loaded_pager )
+                {
+                    return false;
+                }
+            }
+
+            world_file = file;
+            colors = *file_colors;
+            chunklist = std::move( loaded_chunks );
+            filled_voxel_counts = std::move( loaded_voxel_counts );
+
+            if ( brick_compression && paging_budget == 0 )
+            {
+                // Compressed bricks live on the heap instead of in the mapping, which the OS can then drop from memory.
+                jobs::job_system_locator::get()->parallel_for( chunk_count, 16, [&] ( uint32_t first, uint32_t last )
+                    {
+                        for ( uint32_t c = first; c < last; c++ )
+                        {
+                            auto& chunk = *chunklist[c];
+                            chunk.packed.pack( chunk.bricks );
+                            chunk.bricks = {};
+                        }
+                    } );
+            }
+
+            if ( loaded_pager )
+            {
+                if ( brick_compression )
+                {
+                    spdlog::info( "Brick compression does not apply to paged worlds, their bricks are read from the file as they are." );
+                }
+                pager = std::move( loaded_pager );
+                streaming_settings.paging_budget = paging_budget;
+                spdlog::info( "Paging bricks with a {} MB host memory budget.", paging_budget / ( 1024 * 1024 ) );
+            }
+
+            spdlog::info( "Mapped world file {} [{} ms]", path, ( std::chrono::steady_clock::now() - begin ).count() / 1'000'000 );
+
+            upload_world();
+            return true;
+        }
+
+        void world::account_chunk( int chunk_index, int64_t sign )
+        {
+            const auto& chunk = chunklist[chunk_index];
+
+            filled_voxels += sign * filled_voxel_counts[chunk_index];
+            dedup_stats.stored_bricks += sign * chunk->brick_count;
+            dedup_stats.compressed_bricks += sign * chunk->packed.size();
+            dedup_stats.compressed_bytes += sign * chunk->packed.size_bytes();
+            dedup_stats.material_bytes += sign * ( chunk->materials.size_bytes() + chunk->material_indices.size_bytes() );
+            for ( const auto& material : chunk->materials )
+            {
+                if ( material.indices != brick_uniform_material )
+                {
+                    dedup_stats.multi_material_bricks += sign;
+                }
+            }
+
+            for ( const auto& index : chunk->indices )
+            {
+                if ( index.bits & brick_loaded_bit )
+                {
+                    dedup_stats.referenced_bricks += sign;
+                }
+                else if ( index.bits & brick_solid_bit )
+                {
+                    dedup_stats.solid_bricks += sign;
+                }
+            }
+        }
+
+        bool world::is_cell_occupied( int x, int y, int z ) const
+        {
+            const int size = dims.chunk_size;
+            const cell_index& index = chunklist[get_chunk_index( { x, y, z } )]->indices[x % size + ( y % size ) * size + ( z % size ) * size * size];
+            return ( index.bits & ( brick_loaded_bit | brick_solid_bit ) ) != 0;
+        }
+
+        glm::ivec3 world::get_cell_position( int chunk_index, uint32_t cell ) const
+        {
+            const int size = dims.chunk_size;
+            const glm::ivec3 chunk_pos( chunk_index % world_size.x, ( chunk_index / world_size.x ) % world_size.y, chunk_index / ( world_size.x * world_size.y ) );
+            return chunk_pos * size + glm::ivec3( cell % size, ( cell / size ) % size, cell / ( size * size ) );
+        }
+
+        void world::upload_cell_distances( vk::CommandBuffer cmd, const std::vector<uint32_t>& cells )
+        {
+            const int cells_xy = dims.get_cells();
+            const int size = dims.chunk_size;
+            const vk::DeviceSize chunk_bytes = get_chunk_index_bytes();
+
+            // Only the LOD word is written, the brick word of the cell is the GPU's.
+            std::vector<uint32_t> words;
+            std::vector<vk::BufferCopy> copies;
+            for ( uint32_t cell : cells )
+            {
+                const glm::ivec3 pos( cell % cells_xy, ( cell / cells_xy ) % cells_xy, cell / ( cells_xy * cells_xy ) );
+                if ( is_cell_occupied( pos.x, pos.y, pos.z ) )
+                {
+                    continue;
+                }
+
+                const glm::ivec3 local = pos % size;
+                const uint32_t chunk_cell = local.x + local.y * size + local.z * size * size;
+                copies.push_back( { words.size() * sizeof( uint32_t ), get_chunk_index( pos ) * chunk_bytes + chunk_cell * sizeof( cell_index ) + offsetof( cell_index, lod ), sizeof( uint32_t ) } );
+                words.push_back( uint32_t( cell_distances.at( cell ) ) << brick_distance_shift );
+            }
+
+            if ( copies.empty() )
+            {
+                return;
+            }
+
+            vulkan::buffer<uint32_t> staging;
+            staging.allocate( words.size() * sizeof( uint32_t ), vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_ONLY );
+            std::memcpy( staging.mapped_data(), words.data(), words.size() * sizeof( uint32_t ) );
+            cmd.copyBuffer( staging.buf, gpu_index_heap.buf, static_cast<uint32_t>( copies.size() ), copies.data() );
+            brick_loader_deletion_queue.push_function( [staging] () mutable { staging.free(); } );
+        }
+
+        void world::prepare_gpu_indices( int chunk_index, cell_index* out ) const
+        {
+            const chunk& chunk = *chunklist[chunk_index];
+            for ( size_t j = 0; j < chunk.indices.size(); j++ )
+            {
+                const cell_index& index = chunk.indices[j];
+                if ( index.bits & brick_loaded_bit )
+                {
+                    // For each brick that has been created, mark it as unloaded (on the gpu) and save the lod bits.
+                    out[j] = { brick_unloaded_bit, index.lod };
+                }
+                else if ( index.bits & brick_solid_bit )
+                {
+                    // Solid cells need no brick, the GPU treats them as a hit as soon as a ray enters.
+                    out[j] = index;
+                }
+                else
+                {
+                    const glm::ivec3 pos = get_cell_position( chunk_index, static_cast<uint32_t>( j ) );
+                    out[j] = { 0, uint32_t( cell_distances.at( pos.x, pos.y, pos.z ) ) << brick_distance_shift };
+                }
+            }
+        }
+
+        void world::release_chunk_bricks( chunk& chunk )
+        {
+            for ( uint32_t gpu_slot : chunk.gpu_slots )
+            {
+                if ( gpu_slot != 0 && gpu_slot != brick_evicted_slot )
+                {
+                    free_brick_slot( gpu_slot - 1 );
+                }
+            }
+            chunk.gpu_slots.clear();
+        }
+
+        void world::free_brick_slot( uint32_t slot )
+        {
+            brick_slots.free( slot );
+            if ( slot_material_blocks[slot] != 0 )
+            {
+                material_blocks.free( slot_material_blocks[slot] - 1 );
+                slot_material_blocks[slot] = 0;
+            }
+        }
+
+        void world::retire_brick_slot( uint32_t slot, uint64_t frame )
+        {
+            brick_slots.retire( slot, frame );
+            if ( slot_material_blocks[slot] != 0 )
+            {
+                material_blocks.retire( slot_material_blocks[slot] - 1, frame );
+                slot_material_blocks[slot] = 0;
+            }
+        }
+
+        void world::release_retired_slots( uint64_t frame )
+        {
+            brick_slots.release_retired( frame );
+            material_blocks.release_retired( frame );
+        }
+
+        uint32_t world::assign_material_block( uint32_t slot, const chunk& chunk, uint32_t chunk_index, uint32_t brick_index )
+        {
+            uint32_t& block = slot_material_blocks[slot];
+            if ( chunk.materials[brick_index].indices == brick_uniform_material )
+            {
+                // An edit left the slot's brick with one material. Traces in flight may still read its old block.
+                if ( block != 0 )
+                {
+                    material_blocks.retire( block - 1, stream_frame );
+                    block = 0;
+                }
+                return 0;
+            }
+
+            if ( block == 0 )
+            {
+                const uint32_t allocated = material_blocks.allocate( { chunk_index, brick_index, static_cast<uint32_t>( stream_frame ) } );
+                block = allocated == brick_no_slot ? 0 : allocated + 1;
+            }
+            return block;
+        }
+
+        void world::upload_chunk( vk::CommandBuffer cmd, int chunk_index )
+        {
+            auto& chunk = chunklist[chunk_index];
+
+            // Stage the chunk's indices and copy them over its slice of the index heap. The heap address does not change.
+            vulkan::buffer<cell_index> index_staging;
+            index_staging.allocate( get_chunk_index_bytes(), vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_ONLY );
+            prepare_gpu_indices( chunk_index, index_staging.mapped_data() );
+
+            vk::BufferCopy copy {};
+            copy.dstOffset = chunk_index * get_chunk_index_bytes();
+            copy.size = get_chunk_index_bytes();
+            cmd.copyBuffer( index_staging.buf, gpu_index_heap.buf, 1, &copy );
+
+            brick_loader_deletion_queue.push_function( [index_staging] () mutable { index_staging.free(); } );
+        }
+
+        void world::upload_world()
+        {
+            auto begin = std::chrono::steady_clock::now();
+            auto worker = vulkan::worker::create( device_ctx );
+            auto* job_sys = jobs::job_system_locator::get();
+
+            const uint32_t cells_per_chunk = dims.chunk_size * dims.chunk_size * dims.chunk_size;
+            const vk::DeviceSize chunk_bytes = get_chunk_index_bytes();
+
+            // generate, import_volume and load only accept a fresh world, so nothing is streaming or counted yet.
+            assert( !gpu_index_heap.buf && !streaming_thread.joinable() );
+
+            // Every chunk's indices live in one heap, chunk i at i * chunk_bytes. Chunks only need a pointer into it.
+            gpu_index_heap.allocate( chunk_bytes * chunk_count, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY );
+            const vk::DeviceAddress heap_address = vulkan::get_buffer_device_address( gpu_index_heap.buf );
+
+            std::fill( chunk_occupancy.begin(), chunk_occupancy.end(), 0 );
+            int occupied_chunks = 0;
+            for ( int i = 0; i < chunklist.size(); i++ )
+            {
+                account_chunk( i, 1 );
+                chunklist[i]->gpu_index_address = heap_address + i * chunk_bytes;
+                world_index_ptrs[i] = chunklist[i]->gpu_index_address;
+                if ( chunklist[i]->has_cells() )
+                {
+                    chunk_occupancy[i / 32] |= 1u << ( i % 32 );
+                    occupied_chunks++;
+                }
+            }
+
+            cell_distances.build( dims.get_cells(), dims.get_cells(), dims.get_cells_height(), [this] ( int x, int y, int z ) { return is_cell_occupied( x, y, z ); } );
+
+            // We don't start with any bricks loaded on the GPU. When rays hit an unloaded brick they will request a load.
+            brick_slots.reset( gpu_brick_heap_capacity );
+            material_blocks.reset( gpu_material_block_capacity );
+            std::fill( slot_material_blocks.begin(), slot_material_blocks.end(), 0 );
+
+            auto allocated = std::chrono::steady_clock::now();
+
+            // Stage the heap through a single arena, as many chunks per batch as fit, with one copy per batch.
+            // The pointer tables and world config ride along with the last batch.
+            const int chunks_per_batch = std::clamp( static_cast<int>( upload_arena_size / chunk_bytes ), 1, chunk_count );
+
+            vulkan::buffer<cell_index> arena;
+            arena.allocate( chunks_per_batch * chunk_bytes, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_ONLY );
+            cell_index* staged = arena.mapped_data();
+
+            std::chrono::steady_clock::duration prepare_time {};
+            std::chrono::steady_clock::duration transfer_time {};
+            int batches = 0;
+
+            for ( int first = 0; first < chunk_count; first += chunks_per_batch )
+            {
+                const int count = std::min( chunks_per_batch, chunk_count - first );
+                const bool last_batch = first + count == chunk_count;
+
+                auto prepare_begin = std::chrono::steady_clock::now();
+                job_sys->parallel_for( count, 16, [&] ( uint32_t begin, uint32_t end )
+                    {
+                        for ( uint32_t c = begin; c < end; c++ )
+                        {
+                            prepare_gpu_indices( first + c, staged + size_t( c ) * cells_per_chunk );
+                        }
+                    } );
+
+                auto transfer_begin = std::chrono::steady_clock::now();
+                prepare_time += transfer_begin - prepare_begin;
+
+                worker->immediate_submit( [&] ( vk::CommandBuffer cmd )
+                    {
+                        vk::BufferCopy copy {};
+                        copy.dstOffset = first * chunk_bytes;
+                        copy.size = count * chunk_bytes;
+                        cmd.copyBuffer( arena.buf, gpu_index_heap.buf, 1, &copy );
+
+                        if ( last_batch )
+                        {
+                            auto staging1 = gpu_world_conf.upload_to_buffer( cmd, &world_conf, sizeof( world_conf ) );
+                            brick_loader_deletion_queue.push_function( [staging1] () mutable { staging1.free(); } );
+
+                            auto staging2 = gpu_world_index_ptrs.upload_to_buffer( cmd, world_index_ptrs.data(), world_index_ptrs.size() * sizeof( uint64_t ) );
+                            brick_loader_deletion_queue.push_function( [staging2] () mutable { staging2.free(); } );
+
+                            auto staging3 = gpu_chunk_occupancy.upload_to_buffer( cmd, chunk_occupancy.data(), chunk_occupancy.size() * sizeof( uint32_t ) );
+                            brick_loader_deletion_queue.push_function( [staging3] () mutable { staging3.free(); } );
+
+                            auto staging4 = gpu_material_colors.upload_to_buffer( cmd, colors.data(), sizeof( material_colors ) );
+                            brick_loader_deletion_queue.push_function( [staging4] () mutable { staging4.free(); } );
+                        }
+                    } );
+
+                transfer_time += std::chrono::steady_clock::now() - transfer_begin;
+                batches++;
+            }
+
+            arena.free();
+
+            // Create a descriptor set for copying uploaded brick data into position on the GPU.
+            vulkan::descriptor_builder::begin( render_ctx->get_descriptor_layout_cache(), render_ctx->get_descriptor_allocator() )
+                .bind_buffer( 0, gpu_brick_payloads.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 1, gpu_placements.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 2, bricks_requested_by_gpu.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 3, gpu_world_index_ptrs.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 4, gpu_brick_heap.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 5, gpu_world_conf.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 6, gpu_brick_occupancy.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 7, gpu_brick_materials.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .bind_buffer( 8, gpu_material_indices.get_info(), vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute )
+                .build( upload_set );
+
+            auto to_ms = [] ( std::chrono::steady_clock::duration d ) { return std::chrono::duration_cast<std::chrono::milliseconds>( d ).count(); };
+            spdlog::info( "Allocation took {} ms [index heap {} ms, index prepare {} ms, index transfer {} ms, {} MB in {} batches]",
+                to_ms( std::chrono::steady_clock::now() - begin ), to_ms( allocated - begin ), to_ms( prepare_time ), to_ms( transfer_time ),
+                ( chunk_bytes * chunk_count ) / ( 1024 * 1024 ), batches );
+            spdlog::info( "Bricks: {} referenced, {} stored ({:.2f}x deduplication), {} solid", dedup_stats.referenced_bricks, dedup_stats.stored_bricks,
+                dedup_stats.referenced_bricks / double( std::max<uint64_t>( dedup_stats.stored_bricks, 1 ) ), dedup_stats.solid_bricks );
+            if ( dedup_stats.compressed_bricks > 0 )
+            {
+                const uint64_t raw_bytes = dedup_stats.compressed_bricks * sizeof( brick );
+                spdlog::info( "Compressed bricks: {} MB to {} MB ({:.2f}x)", raw_bytes / ( 1024 * 1024 ), dedup_stats.compressed_bytes / ( 1024 * 1024 ),
+                    raw_bytes / double( std::max<uint64_t>( dedup_stats.compressed_bytes, 1 ) ) );
+            }
+            spdlog::info( "Chunks: {} of {} have cells, the others are crossed in one traversal step", occupied_chunks, chunk_count );
+            const cell_distance_stats& distance_stats = cell_distances.get_stats();
+            spdlog::info( "Cell distances: {} cells in {:.1f} ms, {} MB on the host, {:.2f} cells on average from an empty cell to the nearest occupied one",
+                distance_stats.cells, distance_stats.build_ms, distance_stats.memory_bytes / ( 1024 * 1024 ), distance_stats.average_distance );
+            spdlog::info( "GPU brick heap: {} slots, {} MB, {} MB occupancy", brick_slots.get_capacity(), gpu_brick_heap.size / ( 1024 * 1024 ), gpu_brick_occupancy.size / ( 1024 * 1024 ) );
+            spdlog::info( "Materials: {} MB on the host, {} bricks with more than one, GPU {} MB palettes and {} blocks of palette entries in {} MB", dedup_stats.material_bytes / ( 1024 * 1024 ),
+                dedup_stats.multi_material_bricks, gpu_brick_materials.size / ( 1024 * 1024 ), material_blocks.get_capacity(), gpu_material_indices.size / ( 1024 * 1024 ) );
+
+            start_streaming();
+        }
+
+        void world::tick( float delta_time )
+        {
+            ZoneScopedN( "world - tick" );
+
+            // Hand this frame's settings to the streaming thread and pick up what it has serviced since. Neither blocks.
+            settings_queue.push( streaming_settings );
+            stats_queue.pop_latest( streamed );
+
+            if ( !pending_edits.empty() )
+            {
+                std::lock_guard lock( edit_mutex );
+                queued_edits.insert( queued_edits.end(), pending_edits.begin(), pending_edits.end() );
+                pending_edits.clear();
+            }
+
+            world_frame++;
+            traced_frames.store( world_frame, std::memory_order_release );
+        }
+
+        void world::edit( const voxel_edit& brush )
+        {
+            // Only the bounds are clipped to the world, the shape stays as it is.
+            const glm::ivec3 world_voxels = world_size * dims.chunk_size * brick_size;
+            voxel_edit clipped = brush;
+            clipped.min = glm::max( glm::min( brush.min, brush.max ), glm::ivec3( 0 ) );
+            clipped.max = glm::min( glm::max( brush.min, brush.max ), world_voxels - 1 );
+            if ( glm::any( glm::greaterThan( clipped.min, clipped.max ) ) )
+            {
+                return;
+            }
+
+            pending_edits.push_back( clipped );
+        }
+
+        brick_dedup_stats world::get_dedup_stats() const
+        {
+            brick_dedup_stats stats = dedup_stats;
+            stats.gpu_placements = streamed.gpu_placements;
+            stats.gpu_uploads = streamed.gpu_uploads;
+            return stats;
+        }
+
+        void world::start_streaming()
+        {
+            if ( streaming_thread.joinable() )
+            {
+                return;
+            }
+
+            streaming_quit.store( false, std::memory_order_release );
+            streaming_thread = std::thread( [this] () { streaming_loop(); } );
+        }
+
+        void world::stop_streaming()
+        {
+            if ( !streaming_thread.joinable() )
+            {
+                return;
+            }
+
+            streaming_quit.store( true, std::memory_order_release );
+            streaming_thread.join();
+        }
+
+        void world::record_request_capacity( vk::CommandBuffer cmd ) const
+        {
+            const uint32_t queue = static_cast<uint32_t>( world_frame % brick_request_queue_count );
+            const vk::DeviceSize offset = queue * sizeof( gpu_brick_load_queue ) + offsetof( gpu_brick_load_queue, request_capacity );
+            cmd.updateBuffer( bricks_requested_by_gpu.buf, offset, sizeof( uint32_t ), &request_capacity );
+
+            vk::MemoryBarrier capacity_written { vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead };
+            cmd.pipelineBarrier( vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, 1, &capacity_written, 0, nullptr, 0, nullptr );
+        }
+
+        bool world::wait_for_trace( uint64_t frame )
+        {
+            // A short timeout so the thread notices when it is asked to stop.
+            const uint64_t timeout_ns = 2'000'000;
+
+            vk::SemaphoreWaitInfo wait_info;
+            wait_info.semaphoreCount = 1;
+            wait_info.pSemaphores = &brick_halt_semaphore;
+            wait_info.pValues = &frame;
+            return device_ctx->device.waitSemaphores( &wait_info, timeout_ns ) == vk::Result::eSuccess;
+        }
+
+        void world::streaming_loop()
+        {
+            // Upload throughput is measured over windows of about a second.
+            auto window_begin = std::chrono::steady_clock::now();
+            uint64_t window_uploads = stream_stats.gpu_uploads;
+            uint64_t window_bytes = stream_stats.upload_bytes;
+
+            while ( true )
+            {
+                // Only stop once every trace submitted so far has its requests serviced, a trace waits on that.
+                if ( streaming_quit.load( std::memory_order_acquire ) && stream_frame >= traced_frames.load( std::memory_order_acquire ) )
+                {
+                    break;
+                }
+
+                // Trace n signals n once its requests are stable. Frame 0 has no trace and is ready immediately.
+                if ( !wait_for_trace( stream_frame ) )
+                {
+                    continue;
+                }
+
+                auto begin = std::chrono::steady_clock::now();
+
+                // Slots evicted while the traces still in flight were submitted can be reused once those traces are done,
+                // which is when the previous brick_request_queue_count - 1 traces have all been serviced.
+                serviced_queue = static_cast<uint32_t>( stream_frame % brick_request_queue_count );
+                if ( stream_frame + 1 >= brick_request_queue_count )
+                {
+                    release_retired_slots( stream_frame + 1 - brick_request_queue_count );
+                }
+
+                settings_queue.pop_latest( stream_settings );
+                stream_stats.residency.budget = stream_settings.gpu_brick_budget;
+
+                update_pager();
+                apply_edits();
+                load_requested_bricks();
+                process_load_queue();
+                stream_frame++;
+
+                stream_stats.frames = stream_frame;
+                stream_stats.service_ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - begin ).count();
+                stream_stats.heap = brick_slots.get_stats();
+                stream_stats.material_blocks = material_blocks.get_stats();
+
+                const double window_seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - window_begin ).count();
+                if ( window_seconds >= 1.0 )
+                {
+                    stream_stats.uploads_per_second = ( stream_stats.gpu_uploads - window_uploads ) / window_seconds;
+                    stream_stats.upload_bytes_per_second = ( stream_stats.upload_bytes - window_bytes ) / window_seconds;
+                    window_begin = std::chrono::steady_clock::now();
+                    window_uploads = stream_stats.gpu_uploads;
+                    window_bytes = stream_stats.upload_bytes;
+                }
+
+                if ( pager )
+                {
+                    stream_stats.paging = pager->get_stats();
+                }
+
+                // If the render thread has fallen behind on reading, it only misses intermediate statistics.
+                stats_queue.push( stream_stats );
+            }
+        }
+
+        void world::update_pager()
+        {
+            if ( !pager )
+            {
+                return;
+            }
+
+            if ( stream_settings.paging_budget > 0 )
+            {
+                pager->set_memory_budget( stream_settings.paging_budget );
+            }
+
+            // Keep the chunks around the camera resident and install anything paged in since the last frame.
+            const glm::ivec3 center = glm::ivec3( stream_settings.focus ) / ( brick_size * dims.chunk_size );
+            for ( int z = center.z - paging_radius; z <= center.z + paging_radius; z++ )
+            {
+                for ( int y = center.y - paging_radius; y <= center.y + paging_radius; y++ )
+                {
+                    for ( int x = center.x - paging_radius; x <= center.x + paging_radius; x++ )
+                    {
+                        if ( x >= 0 && x < world_size.x && y >= 0 && y < world_size.y && z >= 0 && z < world_size.z )
+                        {
+                            pager->touch( x + y * world_size.x + z * world_size.x * world_size.y );
+                        }
+                    }
+                }
+            }
+
+            pager->update( chunklist );
+        }
+
+        void world::load_requested_bricks()
+        {
+            ZoneScopedN( "world - load bricks" );
+
+            // The streaming loop has already waited for the trace that wrote the requests.
+            loader_frames++;
+            uint64_t signal_value = loader_frames;
+
+            stream_stats.brick_loads = 0;
+            stream_stats.edits.dirty_cells = 0;
+
+            // Check to see if any bricks have been requested.
+            gpu_brick_load_queue* requested_bricks = bricks_requested_by_gpu.mapped_data() + serviced_queue;
+            // The count keeps going up after the queue fills, the requests past the trace's capacity were dropped and never written.
+            const uint32_t written_requests = std::min( requested_bricks->request_capacity, static_cast<uint32_t>( brick_load_queue_size ) );
+            uint32_t brick_to_load_count = std::min( written_requests, requested_bricks->load_queue_count );
+            // The queue is uncached mapped memory. Each request is read from it once here, the sort below reads the copy many times.
+            const std::vector<glm::ivec4> requests( requested_bricks->bricks_to_load, requested_bricks->bricks_to_load + brick_to_load_count );
+
+            // Make room for this tick's requests within the GPU brick budget. Some requests may reuse bricks already on the GPU, so this can over estimate.
+            const uint32_t bricks_wanted = brick_slots.get_used() + std::min( brick_to_load_count, stream_settings.upload_budget );
+            const uint32_t budget = stream_stats.residency.budget;
+            const uint32_t bricks_over_budget = bricks_wanted > budget ? bricks_wanted - budget : 0;
+
+            if ( brick_to_load_count > 0 || bricks_over_budget > 0 || !edited_cells.empty() )
+            {
+                stream_stats.brick_loads = brick_to_load_count;
+
+                oubound_bricks = 0;
+
+                brick_loader_cmd.reset( {} );
+                vk::CommandBufferBeginInfo begin_info {};
+                brick_loader_cmd.begin( begin_info );
+
+                // Edits go first. Evictions may reset cells that were just patched, so they are ordered after the patches.
+                if ( !edited_cells.empty() )
+                {
+                    upload_edits( brick_loader_cmd );
+
+                    vk::MemoryBarrier patches_complete { vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferWrite };
+                    brick_loader_cmd.pipelineBarrier( vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, 1, &patches_complete, 0, nullptr, 0, nullptr );
+                }
+
+                // Evictions are recorded before the requests below, so a slot freed here can be reused by them.
+                if ( bricks_over_budget > 0 )
+                {
+                    evict_bricks( brick_loader_cmd, bricks_over_budget );
+                }
+
+                // Serve the nearest requests first, so the ones put off by the upload or GPU brick budget are the furthest away.
+                // The GPU hands out queue entries in no particular order.
+                std::vector<uint32_t> request_order( brick_to_load_count );
+                for ( uint32_t i = 0; i < brick_to_load_count; i++ )
+                {
+                    request_order[i] = i;
+                }
+                std::stable_sort( request_order.begin(), request_order.end(), [&requests] ( uint32_t a, uint32_t b ) { return requests[a].w < requests[b].w; } );
+
+                // Write the requested bricks to the host->GPU buffers. Placement i answers request i, whatever order they are served in.
+                // Bricks travel encoded and the placement kernel decodes them, so the transfer scales with the compressed size.
+                std::vector<uint32_t> payload_words;
+                uint32_t uploads = 0;
+                std::vector<gpu_brick_placement> placements( brick_to_load_count );
+                for ( uint32_t i : request_order )
+                {
+                    const glm::ivec3 pos = requests[i];
+
+                    // Determine the chunk this brick resides in.
+                    const auto chunk_index = get_chunk_index( pos );
+                    const auto& chunk = chunklist[chunk_index];
+                    const glm::ivec3 brick_pos = pos % dims.chunk_size;
+
+                    // Look up the index for the brick within the chunk.
+                    const uint32_t index_of_index = brick_pos.x + brick_pos.y * dims.chunk_size + brick_pos.z * dims.chunk_size * dims.chunk_size;
+                    const cell_index& index = chunk->indices[index_of_index];
+
+                    if ( !( index.bits & brick_loaded_bit ) )
+                    {
+                        // Edited to empty or solid since it was requested. The edit already patched the cell, this only keeps it that way.
+                        placements[i] = { index.bits, brick_no_payload };
+                        oubound_bricks++;
+                        continue;
+                    }
+
+                    if ( pager && !pager->acquire( chunk_index ) )
+                    {
+                        // The chunk's bricks are still on disk. Clear the requested bit so the GPU asks again once the chunk is paged in.
+                        placements[i] = { brick_unloaded_bit, brick_no_payload };
+                        oubound_bricks++;
+                        continue;
+                    }
+
+                    // Cells sharing a CPU brick share its GPU copy, so only the first request for a brick uploads it.
+                    const uint32_t brick_index = index.bits & brick_index_bits;
+                    if ( chunk->gpu_slots.empty() )
+                    {
+                        chunk->gpu_slots.resize( chunk->brick_count, 0 );
+                    }
+
+                    uint32_t& gpu_slot = chunk->gpu_slots[brick_index];
+                    if ( gpu_slot != 0 && gpu_slot != brick_evicted_slot )
+                    {
+                        placements[i] = { ( gpu_slot - 1 ) | brick_loaded_bit, brick_no_payload };
+                    }
+                    else
+                    {
+                        if ( uploads >= stream_settings.upload_budget )
+                        {
+                            // This frame's uploads went to nearer bricks. Clear the requested bit so the GPU asks again.
+                            placements[i] = { brick_unloaded_bit, brick_no_payload };
+                            stream_stats.throttled_loads++;
+                            oubound_bricks++;
+                            continue;
+                        }
+
+                        const uint32_t slot = brick_slots.get_used() < budget
+                            ? brick_slots.allocate( { static_cast<uint32_t>( chunk_index ), brick_index, static_cast<uint32_t>( stream_frame ) } )
+                            : brick_no_slot;
+                        if ( slot == brick_no_slot )
+                        {
+                            // The budget is spent on bricks in view. Clear the requested bit so the GPU asks again once slots are freed.
+                            placements[i] = { brick_unloaded_bit, brick_no_payload };
+                            stream_stats.residency.deferred_loads++;
+                            oubound_bricks++;
+                            continue;
+                        }
+
+                        if ( gpu_slot == brick_evicted_slot )
+                        {
+                            stream_stats.residency.reloads++;
+                        }
+
+                        // Place data for GPU upload into its heap slot. A brick with more than one material brings its palette entries after it.
+                        const brick_material& material = chunk->materials[brick_index];
+                        const uint32_t material_block = assign_material_block( slot, *chunk, static_cast<uint32_t>( chunk_index ), brick_index );
+                        placements[i] = { slot | brick_loaded_bit, static_cast<uint32_t>( payload_words.size() ), material.palette, material_block };
+                        if ( chunk->packed.empty() )
+                        {
+                            uint32_t encoded[brick_codec_max_words];
+                            const uint32_t count = encode_brick( chunk->bricks[brick_index], encoded );
+                            payload_words.insert( payload_words.end(), encoded, encoded + count );
+                        }
+                        else
+                        {
+                            // A compressed chunk's bricks are already encoded and are copied as they are.
+                            const uint32_t* encoded = chunk->packed.get_encoded( brick_index );
+                            payload_words.insert( payload_words.end(), encoded, encoded + encoded_brick_words( encoded[0] ) );
+                        }
+                        if ( material_block != 0 )
+                        {
+                            const uint32_t* material_indices = chunk->get_material_indices( brick_index );
+                            payload_words.insert( payload_words.end(), material_indices, material_indices + material_index_words );
+                        }
+                        uploads++;
+                        gpu_slot = slot + 1;
+                    }
+
+                    stream_stats.gpu_placements++;
+                    oubound_bricks++;
+                }
+
+                stream_stats.gpu_uploads += uploads;
+                stream_stats.upload_bytes += payload_words.size() * sizeof( uint32_t );
+
+                if ( !payload_words.empty() )
+                {
+                    auto staging_bricks = gpu_brick_payloads.upload_to_buffer( brick_loader_cmd, payload_words.data(), payload_words.size() * sizeof( uint32_t ) );
+                    brick_loader_deletion_queue.push_function( [staging_bricks] () mutable { staging_bricks.free(); } );
+                }
+
+                if ( !placements.empty() )
+                {
+                    auto staging_placements = gpu_placements.upload_to_buffer( brick_loader_cmd, placements.data(), placements.size() * sizeof( gpu_brick_placement ) );
+                    brick_loader_deletion_queue.push_function( [staging_placements] () mutable { staging_placements.free(); } );
+                }
+
+                brick_loader_cmd.end();
+
+                // The previous frame's placement may still be reading gpu_brick_payloads and writing cells this frame writes too.
+                const uint64_t placed_value = proc_frames;
+
+                vk::TimelineSemaphoreSubmitInfo timeline_info;
+                timeline_info.waitSemaphoreValueCount = 1;
+                timeline_info.pWaitSemaphoreValues = &placed_value;
+                timeline_info.signalSemaphoreValueCount = 1;
+                timeline_info.pSignalSemaphoreValues = &signal_value;
+                auto submit_info = vulkan::submit_info( &brick_loader_cmd );
+
+                vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eTransfer;
+
+                submit_info.pNext = &timeline_info;
+                submit_info.pWaitDstStageMask = &wait_stage;
+                submit_info.waitSemaphoreCount = 1;
+                submit_info.pWaitSemaphores = &brick_proc_semaphore;
+                submit_info.signalSemaphoreCount = 1;
+                submit_info.pSignalSemaphores = &brick_load_semaphore;
+
+                VK_CHECK( render_ctx->get_transfer_queue().submit( 1, &submit_info, nullptr ) );
+            }
+            else
+            {
+                vk::SemaphoreSignalInfo signal_info {};
+                signal_info.semaphore = brick_load_semaphore;
+                signal_info.value = signal_value;
+
+                VK_CHECK( device_ctx->device.signalSemaphore( &signal_info ) );
+            }
+        }
+
+        void world::read_brick_stamps()
+        {
+            ZoneScopedN( "world - read brick stamps" );
+
+            const vk::DeviceSize touched_bytes = vk::DeviceSize( brick_slots.get_touched() ) * sizeof( uint32_t );
+            if ( touched_bytes == 0 )
+            {
+                return;
+            }
+
+            brick_stamp_cmd.reset( {} );
+            auto begin_info = vulkan::command_buffer_begin_info( vk::CommandBufferUsageFlagBits::eOneTimeSubmit );
+            VK_CHECK( brick_stamp_cmd.begin( &begin_info ) );
+
+            vk::BufferCopy copy { 0, 0, touched_bytes };
+            brick_stamp_cmd.copyBuffer( gpu_brick_stamps.buf, gpu_brick_stamp_readback.buf, 1, &copy );
+
+            auto to_host = gpu_brick_stamp_readback.get_memory_barrier( vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead );
+            brick_stamp_cmd.pipelineBarrier( vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, {}, 0, nullptr, 1, &to_host, 0, nullptr );
+
+            brick_stamp_cmd.end();
+
+            // The streaming loop has seen trace stream_frame finish; waiting on its signal also makes the trace's stamp writes visible to the copy.
+            const uint64_t traced_value = stream_frame;
+
+            vk::TimelineSemaphoreSubmitInfo timeline_info;
+            timeline_info.waitSemaphoreValueCount = 1;
+            timeline_info.pWaitSemaphoreValues = &traced_value;
+            auto submit_info = vulkan::submit_info( &brick_stamp_cmd );
+
+            vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eTransfer;
+
+            submit_info.pNext = &timeline_info;
+            submit_info.pWaitDstStageMask = &wait_stage;
+            submit_info.waitSemaphoreCount = 1;
+            submit_info.pWaitSemaphores = &brick_halt_semaphore;
+
+            VK_CHECK( render_ctx->get_transfer_queue().submit( 1, &submit_info, brick_stamp_fence ) );
+            VK_CHECK( device_ctx->device.waitForFences( 1, &brick_stamp_fence, true, std::numeric_limits<uint64_t>::max() ) );
+            VK_CHECK( device_ctx->device.resetFences( 1, &brick_stamp_fence ) );
+
+            // The readback memory need not be host coherent.
+            vmaInvalidateAllocation( device_ctx->allocator, gpu_brick_stamp_readback.allocation, 0, touched_bytes );
+        }
+
+        void world::evict_bricks( vk::CommandBuffer cmd, uint32_t needed )
+        {
+            ZoneScopedN( "world - evict bricks" );
+
+            auto begin = std::chrono::steady_clock::now();
+
+            // Evict a batch beyond what is needed right now, so streaming at the budget does not scan the heap every tick.
+            // Bricks traced in the latest frame are in view; evicting them would only bring them straight back.
+            std::vector<uint32_t> victims;
+            // Trace stream_frame is the latest to have stamped bricks. Bricks placed in the last traces in flight may not have been traced yet.
+            read_brick_stamps();
+            const uint64_t protect_loaded_frame = stream_frame > brick_request_queue_count ? stream_frame - brick_request_queue_count : 0;
+            brick_slots.select_least_recently_used( gpu_brick_stamp_readback.mapped_data(), static_cast<uint32_t>( stream_frame ), static_cast<uint32_t>( protect_loaded_frame ), std::max( needed, stream_stats.residency.budget / 32 ), victims );
+            if ( victims.empty() )
+            {
+                return;
+            }
+
+            // Group the victims by chunk so each chunk's cells are scanned once.
+            std::sort( victims.begin(), victims.end(), [this] ( uint32_t a, uint32_t b ) { return brick_slots.get_owner( a ).chunk_index < brick_slots.get_owner( b ).chunk_index; } );
+
+            const vk::DeviceSize chunk_bytes = get_chunk_index_bytes();
+            std::vector<vk::BufferCopy> cell_resets;
+            std::vector<uint8_t> evicted;
+
+            for ( size_t first = 0; first < victims.size(); )
+            {
+                const uint32_t chunk_index = brick_slots.get_owner( victims[first] ).chunk_index;
+                auto& chunk = *chunklist[chunk_index];
+                evicted.assign( chunk.brick_count, 0 );
+
+                size_t last = first;
+                for ( ; last < victims.size() && brick_slots.get_owner( victims[last] ).chunk_index == chunk_index; last++ )
+                {
+                    const uint32_t brick_index = brick_slots.get_owner( victims[last] ).brick_index;
+                    evicted[brick_index] = 1;
+                    chunk.gpu_slots[brick_index] = brick_evicted_slot;
+                    // Traces already submitted may still read the cells being reset, so the slot is not rewritten until they are done.
+                    retire_brick_slot( victims[last], stream_frame );
+                }
+
+                // Every cell sharing an evicted brick goes back to unloaded. Only the flag word is written, the LOD word stays.
+                for ( size_t j = 0; j < chunk.indices.size(); j++ )
+                {
+                    const cell_index& index = chunk.indices[j];
+                    if ( ( index.bits & brick_loaded_bit ) && evicted[index.bits & brick_index_bits] )
+                    {
+                        cell_resets.push_back( { 0, chunk_index * chunk_bytes + j * sizeof( cell_index ), sizeof( uint32_t ) } );
+                    }
+                }
+
+                first = last;
+            }
+
+            if ( !cell_resets.empty() )
+            {
+                // Every reset copies the same unloaded word.
+                vulkan::buffer<uint32_t> unloaded_word;
+                unloaded_word.allocate( sizeof( uint32_t ), vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_ONLY );
+                *unloaded_word.mapped_data() = brick_unloaded_bit;
+                cmd.copyBuffer( unloaded_word.buf, gpu_index_heap.buf, static_cast<uint32_t>( cell_resets.size() ), cell_resets.data() );
+                brick_loader_deletion_queue.push_function( [unloaded_word] () mutable { unloaded_word.free(); } );
+            }
 
-            if ( oubound_bricks > 0 )
+            stream_stats.residency.evictions += victims.size();
+            stream_stats.residency.eviction_passes++;
+            stream_stats.residency.last_pass_ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - begin ).count();
+        }
+
+        void world::apply_edits()
+        {
+            ZoneScopedN( "world - apply edits" );
+
+            // Edits still waiting for the pager go first, so the edits to a chunk keep their order.
+            std::vector<voxel_edit> edits;
+            edits.swap( deferred_edits );
             {
-                auto cmd = brick_processor_cmd;
-                cmd.reset( {} );
-                vk::CommandBufferBeginInfo begin_info {};
-                cmd.begin( begin_info );
+                std::lock_guard lock( edit_mutex );
+                edits.insert( edits.end(), queued_edits.begin(), queued_edits.end() );
+                queued_edits.clear();
+            }
 
-                // The load queue is populated during world intersection tests.
-                // If the load queue is not full and a brick is intersected, but not loaded, 
-                // the load queue count will be incremented and the brick's world position placed in bricks_to_load.
+            if ( edits.empty() )
+            {
+                return;
+            }
+
+            auto begin = std::chrono::steady_clock::now();
+
+            // Split the edits by chunk. The pager is only used here, on the streaming thread.
+            struct chunk_edit
+            {
+                int chunk_index;
+                voxel_edit edit;
+            };
+            std::vector<chunk_edit> chunk_edits;
+
+            // Whether each chunk is paged in is decided once per batch. A chunk paging in part way through would otherwise take a newer
+            // edit while an older one is deferred again.
+            std::unordered_map<int, bool> acquired;
 
-                // Sync chunks with the GPU.
-                bool had_reallocations {};
-                for ( auto& chunk : chunklist )
+            const int chunk_voxels = dims.chunk_size * brick_size;
+            for ( const voxel_edit& edit : edits )
+            {
+                const glm::ivec3 min_chunk = edit.min / chunk_voxels;
+                const glm::ivec3 max_chunk = edit.max / chunk_voxels;
+                for ( int z = min_chunk.z; z <= max_chunk.z; z++ )
                 {
-                    // Reallocate any chunk brick buffers that are now too small.
-                    if ( chunk->gpu_index_highest >= ( chunk->gpu_bricks.size / sizeof( brick ) ) )
+                    for ( int y = min_chunk.y; y <= max_chunk.y; y++ )
                     {
-                        const int new_size = std::pow( 2.0, std::ceil( std::log2( chunk->gpu_index_highest + 1 ) ) );
+                        for ( int x = min_chunk.x; x <= max_chunk.x; x++ )
+                        {
+                            const int chunk_index = x + y * world_size.x + z * world_size.x * world_size.y;
+                            const glm::ivec3 chunk_origin = glm::ivec3( x, y, z ) * chunk_voxels;
+                            voxel_edit clipped = edit;
+                            clipped.min = glm::max( edit.min, chunk_origin );
+                            clipped.max = glm::min( edit.max, chunk_origin + chunk_voxels - 1 );
 
-                        vulkan::buffer<brick> new_bricks;
-                        new_bricks.allocate( new_size * sizeof( brick ), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eShaderDeviceAddress, VMA_MEMORY_USAGE_GPU_ONLY );
+                            if ( pager )
+                            {
+                                auto found = acquired.find( chunk_index );
+                                if ( found == acquired.end() )
+                                {
+                                    found = acquired.emplace( chunk_index, pager->acquire( chunk_index ) ).first;
+                                }
+                                if ( !found->second )
+                                {
+                                    deferred_edits.push_back( clipped );
+                                    continue;
+                                }
+                            }
 
-                        // Copy the contents of the previous brick buffer into the new brick buffer.
-                        vk::BufferCopy copy {};
-                        copy.size = chunk->gpu_bricks.size;
-                        cmd.copyBuffer( chunk->gpu_bricks.buf, new_bricks.buf, 1, &copy );
+                            chunk_edits.push_back( { chunk_index, clipped } );
+                        }
+                    }
+                }
+            }
+
+            // Group by chunk, keeping the order of the edits within each chunk.
+            std::stable_sort( chunk_edits.begin(), chunk_edits.end(), [] ( const chunk_edit& a, const chunk_edit& b ) { return a.chunk_index < b.chunk_index; } );
+            std::vector<uint32_t> chunk_starts;
+            for ( uint32_t i = 0; i < chunk_edits.size(); i++ )
+            {
+                if ( i == 0 || chunk_edits[i].chunk_index != chunk_edits[i - 1].chunk_index )
+                {
+                    chunk_starts.push_back( i );
+                }
+            }
+            const uint32_t edited_chunks = static_cast<uint32_t>( chunk_starts.size() );
+            chunk_starts.push_back( static_cast<uint32_t>( chunk_edits.size() ) );
+
+            // Chunks share nothing an edit writes, so each is edited by its own job.
+            std::vector<chunk_edit_output> outputs( edited_chunks );
+            jobs::job_system_locator::get()->parallel_for( edited_chunks, 1, [&] ( uint32_t first, uint32_t last )
+                {
+                    for ( uint32_t c = first; c < last; c++ )
+                    {
+                        for ( uint32_t i = chunk_starts[c]; i < chunk_starts[c + 1]; i++ )
+                        {
+                            edit_chunk( chunk_edits[i].chunk_index, chunk_edits[i].edit, outputs[c] );
+                        }
+                    }
+                } );
+
+            stream_stats.edits.last_batch_bricks = 0;
+            for ( uint32_t c = 0; c < edited_chunks; c++ )
+            {
+                auto& out = outputs[c];
+                edited_cells.insert( edited_cells.end(), out.cells.begin(), out.cells.end() );
+                for ( uint32_t slot : out.released_slots )
+                {
+                    retire_brick_slot( slot, stream_frame );
+                }
+                stream_stats.edits.copied_bricks += out.copied_bricks;
+                stream_stats.edits.last_batch_bricks += out.touched_bricks;
+
+                if ( pager )
+                {
+                    pager->pin( chunk_edits[chunk_starts[c]].chunk_index );
+                }
+            }
+
+            stream_stats.edits.edits += edits.size();
+            stream_stats.edits.touched_bricks += stream_stats.edits.last_batch_bricks;
+            stream_stats.edits.last_batch_edits = static_cast<uint32_t>( edits.size() );
+            stream_stats.edits.last_batch_chunks = edited_chunks;
+            stream_stats.edits.deferred_edits = static_cast<uint32_t>( deferred_edits.size() );
+            stream_stats.edits.last_apply_ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - begin ).count();
+
+            if ( edits.size() > 0 && stream_stats.edits.last_apply_ms > 1.0 )
+            {
+                spdlog::info( "Applied {} edits to {} chunks, {} bricks, in {:.2f} ms ({:.3f} ms per edit)", edits.size(), edited_chunks, stream_stats.edits.last_batch_bricks,
+                    stream_stats.edits.last_apply_ms, stream_stats.edits.last_apply_ms / edits.size() );
+            }
+        }
+
+        void world::edit_chunk( int chunk_index, const voxel_edit& edit, chunk_edit_output& out )
+        {
+            auto& chunk = *chunklist[chunk_index];
+            prepare_chunk_for_edit( chunk );
+
+            // Each brick the edit touches gets the mask of the voxels it covers.
+            const glm::ivec3 min_brick = edit.min / brick_size;
+            const glm::ivec3 max_brick = edit.max / brick_size;
+            for ( int z = min_brick.z; z <= max_brick.z; z++ )
+            {
+                for ( int y = min_brick.y; y <= max_brick.y; y++ )
+                {
+                    for ( int x = min_brick.x; x <= max_brick.x; x++ )
+                    {
+                        brick mask {};
+                        if ( !brush_brick_mask( edit, glm::ivec3( x, y, z ) * brick_size, mask ) )
+                        {
+                            continue;
+                        }
+
+                        const glm::ivec3 cell_pos = glm::ivec3( x, y, z ) % dims.chunk_size;
+                        const uint32_t cell = cell_pos.x + cell_pos.y * dims.chunk_size + cell_pos.z * dims.chunk_size * dims.chunk_size;
+                        edit_cell( chunk, chunk_index, cell, mask, edit, out );
+                        out.touched_bricks++;
+                    }
+                }
+            }
+        }
+
+        void world::edit_cell( chunk& chunk, int chunk_index, uint32_t cell, const brick& mask, const voxel_edit& edit, chunk_edit_output& out )
+        {
+            cell_index& index = chunk.indices[cell];
 
-                        // Schedule the old brick buffer for deallocation.
-                        vulkan::buffer<brick> old_bricks = chunk->gpu_bricks;
-                        brick_loader_deletion_queue.push_function( [old_bricks] () mutable { old_bricks.free(); } );
+            brick edited {};
+            uint8_t voxel_materials[brick_size * brick_size * brick_size] {};
+            uint32_t brick_index = brick_no_slot;
+            if ( index.bits & brick_loaded_bit )
+            {
+                brick_index = index.bits & brick_index_bits;
+                edited = chunk.bricks[brick_index];
+                unpack_brick_materials( chunk.materials[brick_index].palette, chunk.get_material_indices( brick_index ), voxel_materials );
+            }
+            else if ( index.bits & brick_solid_bit )
+            {
+                std::fill( std::begin( edited.data ), std::end( edited.data ), 0xFFFFFFFFu );
+                std::fill( std::begin( voxel_materials ), std::end( voxel_materials ), static_cast<uint8_t>( ( index.lod & brick_material_bits ) >> brick_material_shift ) );
+            }
 
-                        // Apply the new buffer and note the address. We will also need to re-upload world pointers.
-                        chunk->gpu_bricks = new_bricks;
-                        chunk->gpu_brick_address = vulkan::get_buffer_device_address( chunk->gpu_bricks.buf );
-                        world_brick_ptrs.brick_buf_pointers[chunk->world_ptr_index] = chunk->gpu_brick_address;
+            const brick original = edited;
+            for ( int w = 0; w < cell_members; w++ )
+            {
+                edited.data[w] = edit.fill ? edited.data[w] | mask.data[w] : edited.data[w] & ~mask.data[w];
+            }
 
-                        had_reallocations = true;
+            // Filling over voxels that are already set repaints them.
+            bool repainted = false;
+            if ( edit.fill )
+            {
+                for ( int v = 0; v < brick_size * brick_size * brick_size; v++ )
+                {
+                    if ( mask.data[v / 32] & ( 1u << ( v % 32 ) ) )
+                    {
+                        repainted |= voxel_materials[v] != edit.material;
+                        voxel_materials[v] = edit.material;
                     }
                 }
+            }
+
+            if ( edited == original && !repainted )
+            {
+                return;
+            }
 
-                if ( had_reallocations )
+            const uint32_t count_before = brick_voxel_count( original );
+            const uint32_t count_after = brick_voxel_count( edited );
+            filled_voxel_counts[chunk_index] += int64_t( count_after ) - int64_t( count_before );
+            filled_voxels.fetch_add( int64_t( count_after ) - int64_t( count_before ), std::memory_order_relaxed );
+
+            const bool was_resident = brick_index != brick_no_slot && brick_index < chunk.gpu_slots.size()
+                && chunk.gpu_slots[brick_index] != 0 && chunk.gpu_slots[brick_index] != brick_evicted_slot;
+
+            uint32_t palette {};
+            uint32_t indices[material_index_words];
+            const bool has_indices = count_after > 0 && pack_brick_materials( edited, voxel_materials, colors, palette, indices );
+            const uint32_t material_bits = ( palette & 0xFFu ) << brick_material_shift;
+
+            if ( count_after == 0 || ( count_after == brick_size * brick_size * brick_size && !has_indices ) )
+            {
+                // Empty cells and full cells of one material need no brick.
+                if ( brick_index != brick_no_slot )
                 {
-                    // Upload new world pointers on the GPU.
-                    auto staging = gpu_world_brick_ptrs.upload_to_buffer( cmd, &world_brick_ptrs, sizeof( gpu_brick_pointers ) );
-                    brick_loader_deletion_queue.push_function( [staging] () mutable { staging.free(); } );
+                    release_edited_brick( chunk, brick_index, out );
+                }
+                index = count_after == 0 ? cell_index {} : cell_index { brick_solid_bit, 0xFFu | material_bits };
+            }
+            else
+            {
+                if ( brick_index == brick_no_slot || chunk.brick_refs[brick_index] > 1 )
+                {
+                    if ( brick_index != brick_no_slot )
+                    {
+                        // Other cells keep the original brick.
+                        release_edited_brick( chunk, brick_index, out );
+                        out.copied_bricks++;
+                    }
+                    brick_index = add_edited_brick( chunk );
+                }
+
+                chunk.bricks[brick_index] = edited;
+                set_edited_materials( chunk, brick_index, palette, has_indices ? indices : nullptr );
+                index = { brick_index | brick_loaded_bit, brick_lod_2x2x2( edited ) | material_bits };
+            }
+
+            out.cells.push_back( { ( uint64_t( chunk_index ) << 32 ) | cell, was_resident } );
+        }
+
+        void world::set_edited_materials( chunk& chunk, uint32_t brick_index, uint32_t palette, const uint32_t* indices )
+        {
+            brick_material& material = chunk.material_storage[brick_index];
+            material.palette = palette;
+
+            if ( !indices )
+            {
+                if ( material.indices != brick_uniform_material )
+                {
+                    chunk.free_material_indices.push_back( material.indices );
+                    material.indices = brick_uniform_material;
+                }
+                return;
+            }
+
+            if ( material.indices == brick_uniform_material )
+            {
+                if ( !chunk.free_material_indices.empty() )
+                {
+                    material.indices = chunk.free_material_indices.back();
+                    chunk.free_material_indices.pop_back();
+                }
+                else
+                {
+                    material.indices = static_cast<uint32_t>( chunk.material_index_storage.size() );
+                    chunk.material_index_storage.resize( chunk.material_index_storage.size() + material_index_words );
+                    chunk.material_indices = chunk.material_index_storage;
+                }
+            }
+            std::copy( indices, indices + material_index_words, &chunk.material_index_storage[material.indices] );
+        }
+
+        void world::prepare_chunk_for_edit( chunk& chunk )
+        {
+            if ( !chunk.packed.empty() )
+            {
+                // Edited bricks are written in place, so an edited chunk is kept uncompressed.
+                chunk.brick_storage = chunk.packed.unpack_all();
+                chunk.packed = {};
+                chunk.bricks = chunk.brick_storage;
+            }
+            if ( chunk.indices.data() != chunk.index_storage.data() )
+            {
+                chunk.index_storage.assign( chunk.indices.begin(), chunk.indices.end() );
+            }
+            if ( chunk.bricks.data() != chunk.brick_storage.data() )
+            {
+                chunk.brick_storage.assign( chunk.bricks.begin(), chunk.bricks.end() );
+            }
+            if ( chunk.materials.data() != chunk.material_storage.data() )
+            {
+                chunk.material_storage.assign( chunk.materials.begin(), chunk.materials.end() );
+            }
+            if ( chunk.material_indices.data() != chunk.material_index_storage.data() )
+            {
+                chunk.material_index_storage.assign( chunk.material_indices.begin(), chunk.material_indices.end() );
+            }
+            chunk.use_storage();
+
+            if ( chunk.brick_refs.empty() && chunk.brick_count > 0 )
+            {
+                chunk.brick_refs.assign( chunk.brick_count, 0 );
+                for ( const cell_index& index : chunk.indices )
+                {
+                    if ( index.bits & brick_loaded_bit )
+                    {
+                        chunk.brick_refs[index.bits & brick_index_bits]++;
+                    }
+                }
+            }
+        }
+
+        uint32_t world::add_edited_brick( chunk& chunk )
+        {
+            uint32_t brick_index;
+            if ( !chunk.free_bricks.empty() )
+            {
+                brick_index = chunk.free_bricks.back();
+                chunk.free_bricks.pop_back();
+            }
+            else
+            {
+                brick_index = chunk.brick_count++;
+                chunk.brick_storage.emplace_back();
+                chunk.bricks = chunk.brick_storage;
+                chunk.material_storage.emplace_back();
+                chunk.materials = chunk.material_storage;
+                chunk.brick_refs.push_back( 0 );
+                if ( !chunk.gpu_slots.empty() )
+                {
+                    chunk.gpu_slots.push_back( 0 );
+                }
+            }
+
+            chunk.brick_refs[brick_index] = 1;
+            return brick_index;
+        }
+
+        void world::release_edited_brick( chunk& chunk, uint32_t brick_index, chunk_edit_output& out )
+        {
+            if ( --chunk.brick_refs[brick_index] > 0 )
+            {
+                return;
+            }
+
+            chunk.free_bricks.push_back( brick_index );
+            set_edited_materials( chunk, brick_index, 0, nullptr );
+
+            // The GPU copy is unused once the edited cells are patched. Traces in flight may still read it.
+            if ( brick_index < chunk.gpu_slots.size() )
+            {
+                const uint32_t gpu_slot = chunk.gpu_slots[brick_index];
+                if ( gpu_slot != 0 && gpu_slot != brick_evicted_slot )
+                {
+                    out.released_slots.push_back( gpu_slot - 1 );
+                }
+                chunk.gpu_slots[brick_index] = 0;
+            }
+        }
+
+        void world::upload_edits( vk::CommandBuffer cmd )
+        {
+            ZoneScopedN( "world - upload edits" );
+
+            // A cell edited several times since the last frame is patched once, from its final state.
+            std::sort( edited_cells.begin(), edited_cells.end(), [] ( const edited_cell& a, const edited_cell& b ) { return a.key < b.key; } );
+            size_t unique_count = 0;
+            for ( size_t i = 0; i < edited_cells.size(); i++ )
+            {
+                if ( unique_count > 0 && edited_cells[unique_count - 1].key == edited_cells[i].key )
+                {
+                    edited_cells[unique_count - 1].was_resident |= edited_cells[i].was_resident;
+                }
+                else
+                {
+                    edited_cells[unique_count++] = edited_cells[i];
+                }
+            }
+            edited_cells.resize( unique_count );
+
+            // Edits may have emptied a chunk or put the first cells into one. Cells are sorted by chunk, so each chunk is checked once.
+            std::vector<uint32_t> occupancy_words;
+            std::vector<vk::BufferCopy> occupancy_word_copies;
+            for ( size_t i = 0; i < edited_cells.size(); i++ )
+            {
+                const uint32_t chunk_index = static_cast<uint32_t>( edited_cells[i].key >> 32 );
+                if ( i > 0 && static_cast<uint32_t>( edited_cells[i - 1].key >> 32 ) == chunk_index )
+                {
+                    continue;
+                }
+
+                const uint32_t bit = 1u << ( chunk_index % 32 );
+                uint32_t& word = chunk_occupancy[chunk_index / 32];
+                const uint32_t updated = chunklist[chunk_index]->has_cells() ? word | bit : word & ~bit;
+                if ( updated != word )
+                {
+                    word = updated;
+                    // Chunks sharing a word are next to each other in the sorted cells, so the word was either just staged or not at all.
+                    if ( !occupancy_word_copies.empty() && occupancy_word_copies.back().dstOffset == ( chunk_index / 32 ) * sizeof( uint32_t ) )
+                    {
+                        occupancy_words.back() = word;
+                    }
+                    else
+                    {
+                        occupancy_word_copies.push_back( { occupancy_words.size() * sizeof( uint32_t ), ( chunk_index / 32 ) * sizeof( uint32_t ), sizeof( uint32_t ) } );
+                        occupancy_words.push_back( word );
+                    }
+                }
+            }
+
+            // Cells that became empty, or stopped being empty, move the distances of the cells around them.
+            glm::ivec3 moved_min( std::numeric_limits<int>::max() );
+            glm::ivec3 moved_max( -1 );
+            for ( const edited_cell& edited : edited_cells )
+            {
+                const glm::ivec3 pos = get_cell_position( static_cast<int>( edited.key >> 32 ), static_cast<uint32_t>( edited.key ) );
+                if ( is_cell_occupied( pos.x, pos.y, pos.z ) != ( cell_distances.at( pos.x, pos.y, pos.z ) == 0 ) )
+                {
+                    moved_min = glm::min( moved_min, pos );
+                    moved_max = glm::max( moved_max, pos );
+                }
+            }
+            if ( moved_max.x >= 0 )
+            {
+                auto distance_begin = std::chrono::steady_clock::now();
+                std::vector<uint32_t> moved;
+                stream_stats.edits.distance_cells += cell_distances.update( moved_min.x, moved_min.y, moved_min.z, moved_max.x, moved_max.y, moved_max.z,
+                    [this] ( int x, int y, int z ) { return is_cell_occupied( x, y, z ); }, moved );
+                stream_stats.edits.distance_changes += moved.size();
+
+                // Edited cells are uploaded whole below, with their distance.
+                const int cells_xy = dims.get_cells();
+                std::erase_if( moved, [&] ( uint32_t cell )
+                    {
+                        const glm::ivec3 pos( cell % cells_xy, ( cell / cells_xy ) % cells_xy, cell / ( cells_xy * cells_xy ) );
+                        const glm::ivec3 local = pos % dims.chunk_size;
+                        const uint64_t key = ( uint64_t( get_chunk_index( pos ) ) << 32 ) | uint32_t( local.x + local.y * dims.chunk_size + local.z * dims.chunk_size * dims.chunk_size );
+                        return std::binary_search( edited_cells.begin(), edited_cells.end(), edited_cell { key, false }, [] ( const edited_cell& a, const edited_cell& b ) { return a.key < b.key; } );
+                    } );
+                upload_cell_distances( cmd, moved );
+                stream_stats.edits.last_distance_ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - distance_begin ).count();
+            }
+
+            const vk::DeviceSize chunk_bytes = get_chunk_index_bytes();
+            std::vector<brick> bricks;
+            std::vector<vk::BufferCopy> brick_copies;
+            std::vector<uint64_t> occupancy;
+            std::vector<vk::BufferCopy> occupancy_copies;
+            std::vector<gpu_brick_material> brick_materials;
+            std::vector<vk::BufferCopy> brick_material_copies;
+            std::vector<uint32_t> palette_entries;
+            std::vector<vk::BufferCopy> palette_entry_copies;
+            std::vector<cell_index> cells;
+            std::vector<vk::BufferCopy> cell_copies;
+            cells.reserve( edited_cells.size() );
+            cell_copies.reserve( edited_cells.size() );
+
+            for ( const edited_cell& edited : edited_cells )
+            {
+                const uint32_t chunk_index = static_cast<uint32_t>( edited.key >> 32 );
+                const uint32_t cell = static_cast<uint32_t>( edited.key );
+                auto& chunk = *chunklist[chunk_index];
+                const cell_index& index = chunk.indices[cell];
+
+                // Solid cells are the same on the CPU and GPU, empty ones add their distance.
+                cell_index gpu_index = index;
+                if ( index.bits & brick_loaded_bit )
+                {
+                    const uint32_t brick_index = index.bits & brick_index_bits;
+                    if ( chunk.gpu_slots.empty() )
+                    {
+                        chunk.gpu_slots.resize( chunk.brick_count, 0 );
+                    }
+
+                    // An edited brick that was on the GPU is uploaded now, so the cell does not fall back to its LOD while it is asked for again.
+                    uint32_t& gpu_slot = chunk.gpu_slots[brick_index];
+                    if ( ( gpu_slot == 0 || gpu_slot == brick_evicted_slot ) && edited.was_resident && brick_slots.get_used() < stream_stats.residency.budget )
+                    {
+                        const uint32_t slot = brick_slots.allocate( { chunk_index, brick_index, static_cast<uint32_t>( stream_frame ) } );
+                        if ( slot != brick_no_slot )
+                        {
+                            gpu_slot = slot + 1;
+                        }
+                    }
+
+                    if ( gpu_slot != 0 && gpu_slot != brick_evicted_slot )
+                    {
+                        const uint32_t slot = gpu_slot - 1;
+                        brick_copies.push_back( { bricks.size() * sizeof( brick ), vk::DeviceSize( slot ) * sizeof( brick ), sizeof( brick ) } );
+                        bricks.push_back( chunk.bricks[brick_index] );
+                        occupancy_copies.push_back( { occupancy.size() * sizeof( uint64_t ), vk::DeviceSize( slot ) * sizeof( uint64_t ), sizeof( uint64_t ) } );
+                        occupancy.push_back( brick_occupancy_4x4x4( bricks.back() ) );
+
+                        const uint32_t block = assign_material_block( slot, chunk, chunk_index, brick_index );
+                        brick_material_copies.push_back( { brick_materials.size() * sizeof( gpu_brick_material ), vk::DeviceSize( slot ) * sizeof( gpu_brick_material ), sizeof( gpu_brick_material ) } );
+                        brick_materials.push_back( { chunk.materials[brick_index].palette, block } );
+                        if ( block != 0 )
+                        {
+                            const uint32_t* material_indices = chunk.get_material_indices( brick_index );
+                            palette_entry_copies.push_back( { palette_entries.size() * sizeof( uint32_t ), vk::DeviceSize( block - 1 ) * material_index_words * sizeof( uint32_t ), material_index_words * sizeof( uint32_t ) } );
+                            palette_entries.insert( palette_entries.end(), material_indices, material_indices + material_index_words );
+                        }
+
+                        gpu_index = { slot | brick_loaded_bit, index.lod };
+                    }
+                    else
+                    {
+                        gpu_index = { brick_unloaded_bit, index.lod };
+                    }
+                }
+                else if ( ( index.bits & brick_solid_bit ) == 0 )
+                {
+                    const glm::ivec3 pos = get_cell_position( chunk_index, cell );
+                    gpu_index.lod = uint32_t( cell_distances.at( pos.x, pos.y, pos.z ) ) << brick_distance_shift;
+                }
+
+                cell_copies.push_back( { cells.size() * sizeof( cell_index ), chunk_index * chunk_bytes + cell * sizeof( cell_index ), sizeof( cell_index ) } );
+                cells.push_back( gpu_index );
+            }
+
+            // One staging buffer, a section per destination: the bricks, their occupancy, their materials, their palette entries, the cells and the chunk occupancy words.
+            const vk::DeviceSize staging_bytes = bricks.size() * sizeof( brick ) + occupancy.size() * sizeof( uint64_t ) + brick_materials.size() * sizeof( gpu_brick_material )
+                + palette_entries.size() * sizeof( uint32_t ) + cells.size() * sizeof( cell_index ) + occupancy_words.size() * sizeof( uint32_t );
+            vulkan::buffer<uint8_t> staging;
+            staging.allocate( staging_bytes, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_ONLY );
+
+            vk::DeviceSize staged = 0;
+            auto stage = [&] ( const auto& section, std::vector<vk::BufferCopy>& copies, vk::Buffer destination )
+            {
+                if ( section.empty() )
+                {
+                    return;
+                }
+                const vk::DeviceSize bytes = section.size() * sizeof( section[0] );
+                std::memcpy( staging.mapped_data() + staged, section.data(), bytes );
+                for ( auto& copy : copies )
+                {
+                    copy.srcOffset += staged;
                 }
+                cmd.copyBuffer( staging.buf, destination, static_cast<uint32_t>( copies.size() ), copies.data() );
+                staged += bytes;
+            };
+            stage( bricks, brick_copies, gpu_brick_heap.buf );
+            stage( occupancy, occupancy_copies, gpu_brick_occupancy.buf );
+            stage( brick_materials, brick_material_copies, gpu_brick_materials.buf );
+            stage( palette_entries, palette_entry_copies, gpu_material_indices.buf );
+            stage( cells, cell_copies, gpu_index_heap.buf );
+            stage( occupancy_words, occupancy_word_copies, gpu_chunk_occupancy.buf );
+            brick_loader_deletion_queue.push_function( [staging] () mutable { staging.free(); } );
+
+            stream_stats.edits.dirty_cells = static_cast<uint32_t>( edited_cells.size() );
+            stream_stats.edits.patched_cells += edited_cells.size();
+            stream_stats.edits.brick_uploads += bricks.size();
+            edited_cells.clear();
+        }
+
+        void world::process_load_queue()
+        {
+            ZoneScopedN( "world - process load queue" );
+
+            std::vector<vk::Semaphore> wait_semaphores = { brick_load_semaphore };
+            std::vector<uint64_t> wait_values = { loader_frames };
+
+            vk::SemaphoreWaitInfo wait_info;
+            wait_info.semaphoreCount = wait_semaphores.size();
+            wait_info.pSemaphores = wait_semaphores.data();
+            wait_info.pValues = wait_values.data();
+            VK_CHECK( device_ctx->device.waitSemaphores( &wait_info, UINT64_MAX ) );
+
+            brick_loader_deletion_queue.flush();
+
+            proc_frames++;
+            uint64_t signal_value = proc_frames;
+
+            if ( oubound_bricks > 0 )
+            {
+                auto cmd = brick_processor_cmd;
+                cmd.reset( {} );
+                vk::CommandBufferBeginInfo begin_info {};
+                cmd.begin( begin_info );
+
+                // The load queue is populated during world intersection tests.
+                // If the load queue is not full and a brick is intersected, but not loaded, 
+                // the load queue count will be incremented and the brick's world position placed in bricks_to_load.
+
+                // Loads write into slots of the brick heap, which has a fixed size, so nothing needs to grow here.
 
                 // Barrier to ensure that all CPU writes are finished before shader access.
                 vk::BufferMemoryBarrier cpu_writes_complete = bricks_requested_by_gpu.get_memory_barrier( vk::AccessFlagBits::eHostWrite, vk::AccessFlagBits::eShaderRead );
@@ -441,8 +2418,14 @@ namespace rebel_road
                 // Copy the bricks into place on the GPU.
                 cmd.bindPipeline( vk::PipelineBindPoint::eCompute, upload_bricks_pipeline );
                 cmd.bindDescriptorSets( vk::PipelineBindPoint::eCompute, upload_bricks_layout, 0, 1, &upload_set, 0, nullptr );
-                cmd.dispatch( oubound_bricks, 1, 1 );
-                cmd.pipelineBarrier( vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, 0, nullptr, 0, nullptr, 0, nullptr );
+                const gpu_placement_constants constants { serviced_queue, oubound_bricks };
+                cmd.pushConstants( upload_bricks_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof( constants ), &constants );
+                cmd.dispatch( ( oubound_bricks * cell_members + brick_placement_group_size - 1 ) / brick_placement_group_size, 1, 1 );
+
+                // Empty the serviced queue for the trace that reuses it, which waits on this submission. Only the count is written and the
+                // placement never reads it, it takes the request count from its push constants, so the reset needs no barrier after the dispatch.
+                // The other queues may be filling up meanwhile.
+                cmd.fillBuffer( bricks_requested_by_gpu.buf, serviced_queue * sizeof( gpu_brick_load_queue ), sizeof( uint32_t ), 0 );
 
                 cmd.end();
 
@@ -463,7 +2446,7 @@ namespace rebel_road
                 submit_info.signalSemaphoreCount = 1;
                 submit_info.pSignalSemaphores = &brick_proc_semaphore;
 
-                VK_CHECK( render_ctx->get_graphics_queue().submit( 1, &submit_info, nullptr ) );
+                VK_CHECK( device_ctx->compute_queue.submit( 1, &submit_info, nullptr ) );
 
                 oubound_bricks = 0;
             }
@@ -476,10 +2459,5 @@ namespace rebel_road
                 VK_CHECK( device_ctx->device.signalSemaphore( &signal_info ) );
             }
         }
-
-        uint32_t world::get_brick_load_count()
-        {
-            return stat_brick_loads;
-        }
     }
 }
\ No newline at end of file
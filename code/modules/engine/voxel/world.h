@@ -4,192 +4,602 @@
 #include "vulkan/render_context.h"
 #include "vulkan/worker.h"
 #include "containers/deletion_queue.h"
-
-constexpr static int grid_size = 4096;
-constexpr static int grid_height = 256;
-constexpr static int chunk_size = 16;
-constexpr static int brick_size = 8;
-
-constexpr static glm::vec3 world_size = { grid_size / chunk_size / brick_size, grid_size / chunk_size / brick_size, grid_height / chunk_size / brick_size };
-constexpr static int chunk_count = world_size.x * world_size.y * world_size.z;
-
-constexpr static int chunk_brick_buffer_starting_size = 16;
-
-constexpr static int cells = grid_size / brick_size;
-constexpr static int cells_height = grid_height / brick_size;
-
-// The amount of uint32_t members holding voxel bit data.
-constexpr static int cell_members = brick_size * brick_size * brick_size / 32;
-
-constexpr static uint64_t voxel_count = grid_size * grid_size * grid_height;
-
-// LOD distance for blocksize 1x1x1 representing 8x8x8.
-constexpr static int lod_distance_8x8x8 = 600'000;
-// LOD distance for blocksize 2x2x2 representing 8x8x8.
-constexpr static int lod_distance_2x2x2 = 100'000;
-
-constexpr static uint32_t brick_index_bits = 0xFFFu;
-constexpr static uint32_t brick_lod_bits = 0xFF000u;
+#include "containers/spsc_queue.h"
+#include "io/mapped_file.h"
+#include "chunk_pager.h"
+#include "brick.h"
+#include "brick_codec.h"
+#include "heightmap_cache.h"
+#include "brick_heap.h"
+#include "brush.h"
+#include "voxel_volume.h"
+#include "distance_field.h"
+#include "material.h"
+
+#include <atomic>
+#include <span>
+#include <mutex>
+#include <thread>
+
+constexpr static uint64_t upload_arena_size = 64ull * 1024 * 1024;   // Largest staging buffer used to upload the world.
+constexpr static uint32_t gpu_brick_heap_capacity = 1u << 21;        // Bricks in the GPU brick heap. 128 MB, the smallest maxStorageBufferRange Vulkan allows.
+constexpr static uint32_t gpu_material_block_capacity = 1u << 18;    // Per voxel palette entries of GPU bricks with more than one material, 128 bytes each.
+
+constexpr static uint32_t brick_index_bits = 0x00FFFFFFu;
+constexpr static uint32_t brick_flag_bits = 0xFF000000u;
+constexpr static uint32_t brick_lod_bits = 0x000000FFu;
+constexpr static uint32_t brick_distance_bits = 0x0000FF00u;            // GPU only: the cell_distance_field distance of an empty cell, in the LOD word.
+constexpr static uint32_t brick_distance_shift = 8;
+constexpr static uint32_t brick_material_bits = 0x0000FF00u;            // The material of a solid cell, or palette entry 0 of a cell's brick, in the LOD word. Empty cells have their distance there.
+constexpr static uint32_t brick_material_shift = 8;
 constexpr static uint32_t brick_loaded_bit = 0x80000000u;
 constexpr static uint32_t brick_unloaded_bit = 0x40000000u;
 constexpr static uint32_t brick_requested_bit = 0x20000000u;
-
-constexpr static int brick_load_queue_size = 1024;
-
-// index format, 32 bits:
-// 123xxxxxxxxx11111111000000000000
+constexpr static uint32_t brick_solid_bit = 0x10000000u;
+
+constexpr static int brick_load_queue_size = 16384;                     // Most requests a queue can hold. The capacity in use is a runtime setting up to this.
+constexpr static uint32_t brick_default_request_capacity = 1024;
+constexpr static uint32_t brick_request_queue_count = 2;                 // Traces in flight, each writing its own request queue.
+constexpr static uint32_t brick_placement_group_size = 64;               // local_size_x of world_upload_bricks.comp, one thread per brick word.
+constexpr static uint32_t brick_no_payload = 0xFFFFFFFFu;
+constexpr static uint32_t brick_payload_words = brick_load_queue_size * ( 1 + cell_members + material_index_words );   // A full request queue of bricks that do not compress, each with more than one material.
+constexpr static uint32_t brick_evicted_slot = 0xFFFFFFFFu;             // chunk::gpu_slots value of a brick that was on the GPU and got evicted.
+
+// index format, 2 x 32 bits:
+// bits: 1234rrrrbbbbbbbbbbbbbbbbbbbbbbbb
 // 1 = loaded
 // 2 = unloaded
 // 3 = requested
-// x = unused??
-// l = brick lod
-// b = brick index
+// 4 = solid, every voxel is set and there is no brick
+// r = reserved flags
+// b = brick index, a slot of the GPU brick heap on the GPU and an index into chunk::bricks on the CPU
+// lod:  rrrrrrrrrrrrrrrrmmmmmmmmllllllll
+// r = reserved
+// m = material id of a solid cell or of the most common material of a cell's brick, the cell's distance for empty cells on the GPU
+// l = brick lod, 2x2x2
+//
+// Only bits is ever written by the GPU, so the request flag can be set with a 32 bit atomic.
 
 namespace rebel_road
 {
     namespace voxel
     {
 
-        struct brick
+        // One cell of chunk::indices. Matches uvec2 in the shaders.
+        struct cell_index
         {
-            // 8^3 brick of voxels
-            // 1 bit per voxel
-            // array index: ( cell_x + cell_y * brick_size + cell_z * brick_size * brick_size ) / ( sizeof( uint32_t ) * 8 )
-            // bit position: ( cell_x + cell_y * brick_size + cell_z * brick_size * brick_size ) % ( sizeof( uint32_t ) * 8 )
-            // index within chunk: x + y * chunk_size + z * chunk_size * chunk_size
-            // index is 12 bits 0xFFF
-            uint32_t data[cell_members];
+            uint32_t bits {};   // Flags and brick index.
+            uint32_t lod {};    // LOD byte and reserved bits.
+
+            bool operator==( const cell_index& other ) const = default;
         };
 
-        struct gpu_index_pointers
+        // World dimensions, given when the world is created. Sizes are in voxels.
+        struct world_dimensions
         {
-            uint64_t index_buf_pointers[chunk_count];
+            int grid_size { 4096 };
+            int grid_height { 256 };
+            int chunk_size { 16 };                  // In bricks. 16 and 32 have precompiled fast paths on the CPU and GPU.
+            int lod_distance_8x8x8 { 600'000 };     // LOD distance for blocksize 1x1x1 representing 8x8x8.
+            int lod_distance_2x2x2 { 100'000 };     // LOD distance for blocksize 2x2x2 representing 8x8x8.
+            int lod_distance_4x4x4 { 30'000 };      // LOD distance for blocksize 4x4x4 representing 8x8x8, from the brick occupancy.
+
+            // Chunks along each axis.
+            glm::ivec3 get_world_size() const { return { grid_size / chunk_size / brick_size, grid_size / chunk_size / brick_size, grid_height / chunk_size / brick_size }; }
+            int get_chunk_count() const { const auto size = get_world_size(); return size.x * size.y * size.z; }
+            int get_cells() const { return grid_size / brick_size; }
+            int get_cells_height() const { return grid_height / brick_size; }
+            uint64_t get_voxel_count() const { return uint64_t( grid_size ) * grid_size * grid_height; }
+
+            // The grid must divide evenly into chunks and a chunk's cells must fit in brick_index_bits.
+            bool is_valid() const
+            {
+                const int chunk_voxels = chunk_size * brick_size;
+                return chunk_size > 0 && grid_size > 0 && grid_height > 0 && grid_height <= UINT16_MAX
+                    && grid_size % chunk_voxels == 0 && grid_height % chunk_voxels == 0
+                    && uint64_t( chunk_size ) * chunk_size * chunk_size <= uint64_t( brick_index_bits ) + 1;
+            }
+
+            bool operator==( const world_dimensions& other ) const = default;
         };
 
-        struct gpu_brick_pointers
+        struct gpu_world_config
         {
-            uint64_t brick_buf_pointers[chunk_count];
+            int grid_size {};
+            int grid_height {};
+            int chunk_size {};
+            int chunk_count {};
+            glm::ivec4 world_size {};
+            int cells {};
+            int cells_height {};
+            int lod_distance_8x8x8 {};
+            int lod_distance_2x2x2 {};
+            int lod_distance_4x4x4 {};
         };
 
-        struct gpu_world_config
+        // Per requested brick, written by the CPU and consumed by world_upload_bricks.comp.
+        struct gpu_brick_placement
+        {
+            uint32_t index {};                      // New cell_index::bits for the requested cell. The LOD word is left as is.
+            uint32_t payload { brick_no_payload };  // Offset of the encoded brick in gpu_brick_payloads to decode into place, or brick_no_payload to only write the index.
+            uint32_t palette {};                    // brick_material::palette of the brick.
+            uint32_t material_block {};             // Block + 1 of gpu_material_indices to copy the brick's palette entries into, which follow the encoded brick. 0 for none.
+        };
+
+        // The materials of a heap slot's brick, written with the brick. Matches uvec2 in the shaders.
+        struct gpu_brick_material
+        {
+            uint32_t palette {};
+            uint32_t block {};                      // Block + 1 of gpu_material_indices holding the palette entry of each voxel, 0 when every voxel is entry 0.
+        };
+
+        // Push constants of world_upload_bricks.comp.
+        struct gpu_placement_constants
+        {
+            uint32_t request_queue {};              // The request queue the placements answer.
+            uint32_t placement_count {};
+        };
+
+        struct placement_benchmark_result
+        {
+            uint32_t bricks_per_tick {};
+            uint32_t ticks {};
+            double gpu_ms {};                       // All ticks, measured with GPU timestamps.
+            double bricks_per_second {};
+            double payload_bytes_per_brick {};      // Encoded size of the benchmark bricks.
+            bool verified {};                       // Every brick and index landed where it should.
+        };
+
+        struct volume_import_stats
         {
-            int grid_size{ ::grid_size };
-            int grid_height{ ::grid_height };
-            int chunk_size{ ::chunk_size };
-            int chunk_count{ ::chunk_count };
-            glm::ivec4 world_size{ ::world_size.x, ::world_size.y, ::world_size.z, 1 };
-            int cells{ ::cells };
-            int cells_height{ ::cells_height };
-            int lod_distance_8x8x8{ ::lod_distance_8x8x8 };
-            int lod_distance_2x2x2{ ::lod_distance_2x2x2 };
+            glm::ivec3 size {};                     // Of the imported volume, in voxels.
+            uint64_t source_voxels {};              // Listed in a .vox file, or every voxel of a raw grid.
+            uint64_t filled_voxels {};              // Landed in the world, the rest was outside it.
+            double read_ms {};                      // Parsing and binning a .vox file, or mapping a raw grid.
+            double build_ms {};                     // Building the chunks, which reads a raw grid.
+            double voxels_per_second {};            // Voxels of the volume inside the world over the whole import.
+        };
+
+        struct brick_dedup_stats
+        {
+            uint64_t referenced_bricks {};          // Cells that hold a brick.
+            uint64_t stored_bricks {};              // Unique bricks stored on the CPU.
+            uint64_t solid_bricks {};               // Cells encoded with brick_solid_bit, which store and upload nothing.
+            uint64_t compressed_bricks {};          // Stored bricks kept compressed.
+            uint64_t compressed_bytes {};           // Host memory of the compressed bricks, against compressed_bricks * sizeof( brick ) uncompressed.
+            uint64_t material_bytes {};             // Host memory of the stored bricks' materials.
+            uint64_t multi_material_bricks {};      // Stored bricks with more than one material, which carry a palette entry per voxel.
+            uint64_t gpu_placements {};             // Requests served with a brick.
+            uint64_t gpu_uploads {};                // Requests that had to upload their brick. The rest reused a brick already on the GPU.
+        };
+
+        struct brick_residency_stats
+        {
+            uint32_t budget {};                     // Most bricks kept on the GPU.
+            uint64_t evictions {};                  // Bricks removed from the GPU to stay within the budget.
+            uint64_t reloads {};                    // Uploads of bricks that had been evicted before.
+            uint64_t deferred_loads {};             // Requests put off because the budget was reached by bricks in view.
+            uint64_t eviction_passes {};
+            double last_pass_ms {};
+        };
+
+        struct brick_edit_stats
+        {
+            uint64_t edits {};                      // Edits applied.
+            uint32_t deferred_edits {};             // Parts of edits waiting for their chunk to be paged in.
+            uint32_t dirty_cells {};                // Cells patched on the GPU in the latest serviced frame.
+            uint64_t patched_cells {};
+            uint64_t brick_uploads {};              // Edited bricks uploaded straight into the brick heap.
+            uint64_t copied_bricks {};              // Bricks shared by several cells, copied before their first edit.
+            uint64_t touched_bricks {};             // Bricks brushes rasterized into, changed or not.
+            // The latest batch of edits, applied to its chunks in parallel.
+            uint32_t last_batch_edits {};
+            uint32_t last_batch_chunks {};
+            uint64_t last_batch_bricks {};
+            double last_apply_ms {};
+            // Cell distances moved by edits, see cell_distance_field.
+            uint64_t distance_cells {};             // Cells recomputed.
+            uint64_t distance_changes {};           // Cells whose distance changed, patched on the GPU.
+            double last_distance_ms {};
+        };
+
+        // Sent by the render thread to the streaming thread every tick.
+        struct brick_streaming_settings
+        {
+            glm::vec3 focus {};                     // Camera position in voxels.
+            uint64_t paging_budget {};              // Host bytes of paged bricks, ignored unless paging.
+            uint32_t gpu_brick_budget { gpu_brick_heap_capacity };
+            uint32_t upload_budget { brick_default_request_capacity };   // Most bricks uploaded per serviced frame. The nearest requests go first.
+        };
+
+        // Sent back by the streaming thread after every frame it services.
+        struct brick_streaming_stats
+        {
+            uint64_t frames {};                     // Traced frames whose brick requests have been serviced.
+            uint32_t brick_loads {};                // Requests in the latest serviced frame.
+            uint64_t throttled_loads {};            // Requests put off by the upload budget, to be asked for again.
+            double service_ms {};                   // CPU time spent servicing the latest frame.
+            uint64_t gpu_placements {};
+            uint64_t gpu_uploads {};
+            uint64_t upload_bytes {};               // Encoded brick payloads staged for placement.
+            // Over the last second of streaming.
+            double uploads_per_second {};
+            double upload_bytes_per_second {};
+            brick_heap_stats heap;
+            brick_heap_stats material_blocks;       // Of gpu_material_indices. Failed allocations show their brick in its most common material.
+            brick_residency_stats residency;
+            brick_edit_stats edits;
+            chunk_pager_stats paging;
         };
 
         struct gpu_brick_load_queue
         {
-            uint32_t load_queue_count { 0 };
-            uint32_t pad1 { 0 };
+            uint32_t load_queue_count { 0 };                    // Requests the trace tried to queue, which may be past request_capacity.
+            uint32_t request_capacity { 0 };                    // Of the trace that filled the queue. Only the requests below it were written.
             uint32_t pad2 { 0 };
             uint32_t pad3 { 0 };
-            glm::ivec4 bricks_to_load[brick_load_queue_size];
+            glm::ivec4 bricks_to_load[brick_load_queue_size];  // Brick position and priority, the squared distance to the camera in bricks.
         };
 
         struct chunk
         {
-            // 16^3 (4096) bricks, 12 bit index to each brick
+            // chunk_size^3 bricks, 24 bit index to each brick
             // index within grid: x + y * world_size.x + z * world_size.x * world_size.y
 
-            std::vector<uint32_t> indices;          // CPU indices
-            vulkan::buffer<uint32_t> gpu_indices;   // GPU indices
-            vk::DeviceAddress gpu_index_address;    // Device address of GPU indices
-
-            std::vector<brick> bricks;              // CPU bricks
-            vulkan::buffer<brick> gpu_bricks;       // GPU bricks
-            vk::DeviceAddress gpu_brick_address;    // Device address of GPU bricks
-
-            int gpu_index_highest {};               // Highest utilized brick index of GPU loaded bricks.
-            uint32_t world_ptr_index {};            // Location of our bricks & indices within gpu_*_pointers.
+            // indices and bricks view either the chunk's own storage or a mapped world file.
+
+            std::span<cell_index> indices;          // CPU indices
+            vk::DeviceAddress gpu_index_address;    // Device address of GPU indices, a slice of world::gpu_index_heap
+
+            std::span<brick> bricks;                // CPU bricks
+            std::span<brick_material> materials;    // One per CPU brick. Kept resident while the bricks are paged.
+            std::span<uint32_t> material_indices;   // material_index_words for each brick_material with indices.
+
+            std::vector<cell_index> index_storage;  // Backing store for indices when not mapped.
+            std::vector<brick> brick_storage;       // Backing store for bricks when not mapped.
+            std::vector<brick_material> material_storage;
+            std::vector<uint32_t> material_index_storage;
+            packed_bricks packed;                   // The bricks, compressed, when the world compresses them. bricks is empty then.
+            uint32_t brick_count {};                // Unique CPU bricks, valid even while bricks are paged out.
+
+            std::vector<uint32_t> gpu_slots;        // Brick heap slot + 1 for each CPU brick already on the GPU, 0 if never loaded, brick_evicted_slot if evicted.
+            uint32_t world_ptr_index {};            // Location of our indices within gpu_world_index_ptrs.
+
+            // Built by the first edit of the chunk. Edits copy a brick before writing to it if other cells use it too.
+            std::vector<uint32_t> brick_refs;       // Cells using each CPU brick.
+            std::vector<uint32_t> free_bricks;      // CPU bricks no cell uses any more, reused by edits.
+            std::vector<uint32_t> free_material_indices;    // Offsets in material_indices no brick uses any more, reused by edits.
+
+            // True when any cell has a brick or is solid. The traversal crosses chunks without one in a single step.
+            bool has_cells() const
+            {
+                return std::any_of( indices.begin(), indices.end(), [] ( const cell_index& index ) { return ( index.bits & ( brick_loaded_bit | brick_solid_bit ) ) != 0; } );
+            }
+
+            // Decodes packed bricks as well.
+            void get_brick( uint32_t brick_index, brick& out ) const
+            {
+                if ( packed.empty() )
+                {
+                    out = bricks[brick_index];
+                }
+                else
+                {
+                    packed.unpack( brick_index, out );
+                }
+            }
+
+            // The palette entry of each voxel of a brick, null when they are all entry 0.
+            const uint32_t* get_material_indices( uint32_t brick_index ) const
+            {
+                const uint32_t offset = materials[brick_index].indices;
+                return offset == brick_uniform_material ? nullptr : &material_indices[offset];
+            }
+
+            // Point the CPU views at the chunk's own storage.
+            void use_storage()
+            {
+                indices = index_storage;
+                bricks = brick_storage;
+                materials = material_storage;
+                material_indices = material_index_storage;
+            }
         };
 
         class world
         {
         public:
 
-            static std::shared_ptr<world> create( vulkan::render_context* in_render_ctx );
+            static std::shared_ptr<world> create( vulkan::render_context* in_render_ctx, const world_dimensions& in_dims = {} );
 
             ~world();
             world() = delete;
-            world( vulkan::render_context* in_render_ctx );
+            world( vulkan::render_context* in_render_ctx, const world_dimensions& in_dims );
 
+            // Generates the terrain on the job system, which must have been provided to jobs::job_system_locator.
+            // Only a fresh world can be generated, create a new world to start over.
             void generate();
             void tick( float delta_time );
 
-            void process_load_queue();
+            // Builds the world from a MagicaVoxel .vox file, or a raw grid of raw_size voxels, instead of generating terrain.
+            // The volume starts at the world origin and is clipped to the world. Chunks are built on the job system.
+            bool import_volume( const std::string& path, const glm::ivec3& raw_size = {} );
+            const volume_import_stats& get_import_stats() const { return import_stats; }
+
+            // Rebuild the chunks in [min_chunk, max_chunk] from the cached heightmap tiles and upload them again.
+            // Waits for the GPU to go idle, meant for editing tools rather than every frame.
+            void regenerate_region( const glm::ivec3& min_chunk, const glm::ivec3& max_chunk );
+
+            // Runs the placement kernel on a full request queue of bricks per tick, into scratch buffers so the world is untouched,
+            // and logs the throughput. Waits for the GPU.
+            placement_benchmark_result benchmark_placement( uint32_t ticks = 64 );
+
+            // Keep the CPU bricks of generated, imported and mapped chunks compressed. Requested bricks are uploaded encoded either way and decoded by the placement kernel.
+            // Must be set before the world is generated, imported or loaded. Bricks paged from disk and edited chunks stay uncompressed.
+            void set_brick_compression( bool enabled ) { brick_compression = enabled; }
+            // Encodes and decodes up to max_bricks of the world's stored bricks and logs the compression ratio and decode throughput.
+            // Streaming pauses while the bricks are copied, edits on the streaming thread replace them.
+            brick_codec_benchmark_result benchmark_brick_codec( uint32_t max_bricks = 1 << 20 );
+
+            // Write the CPU world to a versioned binary world file. Streaming pauses while it is written.
+            bool save( const std::string& path );
+            // Map a world file written by save(). Chunk indices and bricks point directly into the mapping.
+            // With a non-zero paging_budget, bricks are instead paged in from the file near the camera and on GPU request,
+            // keeping at most paging_budget bytes of bricks resident on the host. Fails on a world that was already generated, imported or loaded.
+            bool load( const std::string& path, uint64_t paging_budget = 0 );
+
+            // The camera position in voxels. Chunks around it are kept resident when paging.
+            // Settings are handed to the streaming thread on the next tick.
+            void set_focus( const glm::vec3& position ) { streaming_settings.focus = position; }
+            void set_paging_budget( uint64_t bytes ) { streaming_settings.paging_budget = bytes; }
+            const chunk_pager_stats* get_paging_stats() const { return pager ? &streamed.paging : nullptr; }
 
             vk::DescriptorBufferInfo get_world_buffer_info() { return gpu_world_conf.get_info(); }
             vk::DescriptorBufferInfo get_index_buffer_info() { return gpu_world_index_ptrs.get_info(); }
-            vk::DescriptorBufferInfo get_brick_buffer_info() { return gpu_world_brick_ptrs.get_info(); }
+            vk::DescriptorBufferInfo get_brick_buffer_info() { return gpu_brick_heap.get_info(); }
             vk::DescriptorBufferInfo get_load_queue_info() { return bricks_requested_by_gpu.get_info(); }
-
-            uint32_t get_brick_load_count();
-            uint64_t get_filled_voxel_count() { return filled_voxels; }
-
-            // Semaphore World -> Ray Tracer 
-            uint64_t get_ray_tracer_wait_value() { return proc_frames; }
+            vk::DescriptorBufferInfo get_brick_stamp_info() { return gpu_brick_stamps.get_info(); }
+            vk::DescriptorBufferInfo get_brick_occupancy_info() { return gpu_brick_occupancy.get_info(); }
+            vk::DescriptorBufferInfo get_chunk_occupancy_info() { return gpu_chunk_occupancy.get_info(); }
+            vk::DescriptorBufferInfo get_brick_material_info() { return gpu_brick_materials.get_info(); }
+            vk::DescriptorBufferInfo get_material_index_info() { return gpu_material_indices.get_info(); }
+            vk::DescriptorBufferInfo get_material_color_info() { return gpu_material_colors.get_info(); }
+
+            // Set by generate and import_volume, and saved with the world.
+            const material_colors& get_material_colors() const { return colors; }
+
+            // Statistics of the streaming thread are as of the latest frame it serviced.
+            uint32_t get_brick_load_count() const { return streamed.brick_loads; }
+            uint64_t get_filled_voxel_count() { return filled_voxels.load( std::memory_order_relaxed ); }
+            brick_dedup_stats get_dedup_stats() const;
+            const cell_distance_stats& get_cell_distance_stats() const { return cell_distances.get_stats(); }
+            const world_dimensions& get_dimensions() const { return dims; }
+            heightmap_cache_stats get_heightmap_stats() const { return heightmaps->get_stats(); }
+            const brick_heap_stats& get_brick_heap_stats() const { return streamed.heap; }
+            const brick_residency_stats& get_residency_stats() const { return streamed.residency; }
+            const brick_streaming_stats& get_streaming_stats() const { return streamed; }
+
+            // Voxel edits, in world voxels. Edits are batched and handed to the streaming thread on the next tick, which applies them in order
+            // and patches only the touched cells and bricks on the GPU. Edits to chunks still on disk wait for them to be paged in.
+            // Filled voxels take material, clearing ignores it.
+            void set_voxel( const glm::ivec3& voxel, uint8_t material = terrain_material_rock ) { edit_region( voxel, voxel, true, material ); }
+            void clear_voxel( const glm::ivec3& voxel ) { edit_region( voxel, voxel, false ); }
+            void edit_region( const glm::ivec3& min_voxel, const glm::ivec3& max_voxel, bool fill, uint8_t material = terrain_material_rock ) { edit( { min_voxel, max_voxel, fill, material } ); }
+            void edit_sphere( const glm::vec3& center, float radius, bool fill, uint8_t material = terrain_material_rock ) { edit( make_sphere_brush( center, radius, fill, material ) ); }
+            void edit_cylinder( const glm::vec3& base_center, float radius, float height, bool fill, uint8_t material = terrain_material_rock ) { edit( make_cylinder_brush( base_center, radius, height, fill, material ) ); }
+            void edit( const voxel_edit& brush );
+
+            // Most bricks to keep on the GPU, at most gpu_brick_heap_capacity. The least recently traced bricks above it are evicted.
+            void set_gpu_brick_budget( uint32_t bricks ) { streaming_settings.gpu_brick_budget = std::clamp( bricks, 1u, gpu_brick_heap_capacity ); }
+            void set_upload_budget( uint32_t bricks ) { streaming_settings.upload_budget = std::max( bricks, 1u ); }
+            // Most requests a trace may queue, at most brick_load_queue_size. Requests past it are dropped and asked for again by a later trace.
+            void set_request_capacity( uint32_t requests ) { request_capacity = std::clamp( requests, 1u, static_cast<uint32_t>( brick_load_queue_size ) ); }
+            uint32_t get_request_capacity() const { return request_capacity; }
+
+            // Chunk size to bake into pipelines that traverse this world, or 0 for the generic path.
+            int get_specialized_chunk_size() const { return ( dims.chunk_size == 16 || dims.chunk_size == 32 ) ? dims.chunk_size : 0; }
+
+            // The frame of the next trace. The traversal shaders stamp it on the bricks they visit and write their requests
+            // to request queue trace_frame % brick_request_queue_count.
+            uint32_t get_trace_frame() const { return static_cast<uint32_t>( world_frame ); }
+            // Writes the request capacity of the next trace into its request queue, so the streaming thread only reads the requests it wrote.
+            // Recorded by the ray tracer ahead of the traversal.
+            void record_request_capacity( vk::CommandBuffer cmd ) const;
+
+            // Semaphore World -> Ray Tracer
+            // Trace n signals n when done. It only waits for the streaming thread to finish with the request queue it is about to reuse,
+            // the one trace n - brick_request_queue_count wrote, so tracing runs ahead of brick placement instead of waiting on every frame.
+            // The wait may be submitted before the streaming thread submits its signal, so the render thread never waits on the CPU.
+            uint64_t get_ray_tracer_wait_value() { return world_frame >= brick_request_queue_count ? world_frame + 1 - brick_request_queue_count : 0; }
             uint64_t get_ray_tracer_signal_value() { return world_frame; }
             vk::Semaphore get_ray_tracer_wait_semaphore() { return brick_proc_semaphore; }
             vk::Semaphore get_ray_tracer_signal_semaphore() { return brick_halt_semaphore; }
 
         private:
-            void generate_chunk( int start_x, int start_y, int start_z );
+            void generate_heightmap_tile( int tile_x, int tile_y, heightmap_tile& tile ) const;
+            void generate_column( int x, int y, int min_z, int max_z );
+            void build_chunk( const heightmap_tile& tile, int x, int y, int z );
+            // fixed_chunk_size is dims.chunk_size for the precompiled sizes, 0 for the generic path.
+            template<int fixed_chunk_size>
+            void generate_chunk( const heightmap_tile& tile, int start_x, int start_y, int start_z );
+            void import_chunk( const voxel_volume& volume, int chunk_index );
+            // Gives a built chunk the pool's unique bricks and their materials, the bricks compressed when brick_compression is set.
+            void store_bricks( chunk& chunk, brick_pool& pool ) const;
+            int get_chunk_index( const glm::ivec3& pos ) const;
+            // Once per world, after its chunks are first built or mapped.
+            void upload_world();
+            void upload_chunk( vk::CommandBuffer cmd, int chunk_index );
+            // Return a chunk's brick heap slots to the allocator, e.g. before its bricks are rebuilt.
+            void release_chunk_bricks( chunk& chunk );
+            // A heap slot goes with the material block of its brick, if it has one.
+            void free_brick_slot( uint32_t slot );
+            void retire_brick_slot( uint32_t slot, uint64_t frame );
+            void release_retired_slots( uint64_t frame );
+            // The material block + 1 for the brick placed in slot, reusing the slot's block if it has one. 0 when the brick needs none or none is free.
+            uint32_t assign_material_block( uint32_t slot, const chunk& chunk, uint32_t chunk_index, uint32_t brick_index );
+            // Converts CPU indices to their initial GPU state, every brick unloaded and every empty cell with its distance.
+            void prepare_gpu_indices( int chunk_index, cell_index* out ) const;
+            vk::DeviceSize get_chunk_index_bytes() const { return vk::DeviceSize( dims.chunk_size ) * dims.chunk_size * dims.chunk_size * sizeof( cell_index ); }
+            bool is_cell_occupied( int x, int y, int z ) const;
+            glm::ivec3 get_cell_position( int chunk_index, uint32_t cell ) const;
+            // The GPU LOD word of the empty cells among cells, numbered as in cell_distances, with their current distance.
+            void upload_cell_distances( vk::CommandBuffer cmd, const std::vector<uint32_t>& cells );
+            // Add (sign 1) or remove (sign -1) a chunk's voxels and bricks from the world statistics.
+            void account_chunk( int chunk_index, int64_t sign );
+
+            bool write_world_file( const std::string& path ) const;
+
+            // The streaming thread. Services each traced frame's brick requests in order, see get_ray_tracer_wait_value.
+            void start_streaming();
+            // Returns once every frame traced so far has been serviced, so no submitted trace is left waiting.
+            void stop_streaming();
+            void streaming_loop();
+            bool wait_for_trace( uint64_t frame );
+            void update_pager();
 
             void load_requested_bricks();
+            void process_load_queue();
+            // Frees the least recently used heap slots until needed more bricks fit the budget, resetting the cells that used them to unloaded.
+            void evict_bricks( vk::CommandBuffer cmd, uint32_t needed );
+            // Copies the stamps of every slot handed out so far into gpu_brick_stamp_readback, waiting for the copy.
+            void read_brick_stamps();
+
+            // Editing, on the streaming thread.
+            struct chunk_edit_output;
+            void apply_edits();
+            // Only touches the chunk and out, so chunks can be edited in parallel.
+            void edit_chunk( int chunk_index, const voxel_edit& edit, chunk_edit_output& out );
+            void edit_cell( chunk& chunk, int chunk_index, uint32_t cell, const brick& mask, const voxel_edit& edit, chunk_edit_output& out );
+            // Stores an edited brick's palette and palette entries, indices being null when the brick has one material. Reuses the brick's entry words.
+            void set_edited_materials( chunk& chunk, uint32_t brick_index, uint32_t palette, const uint32_t* indices );
+            // Moves a chunk's mapped indices and bricks into its own storage and counts the cells using each brick.
+            void prepare_chunk_for_edit( chunk& chunk );
+            uint32_t add_edited_brick( chunk& chunk );
+            void release_edited_brick( chunk& chunk, uint32_t brick_index, chunk_edit_output& out );
+            // Uploads the final state of every cell edited since the last frame, and the bricks of those that stay on the GPU.
+            void upload_edits( vk::CommandBuffer cmd );
+
+            world_dimensions dims;
+            glm::ivec3 world_size {};                       // In chunks, cached from dims.
+            int chunk_count {};
 
             std::vector<std::unique_ptr<chunk>> chunklist;
             std::vector<uint64_t> filled_voxel_counts;
+            std::unique_ptr<heightmap_cache> heightmaps;   // Generated terrain, shared by the chunks of a column.
+            std::shared_ptr<io::mapped_file> world_file;   // Keeps mapped chunk data alive for a loaded world.
+            std::unique_ptr<chunk_pager> pager;            // Only present when a world was loaded with a paging budget. Owned by the streaming thread.
+            int paging_radius { 2 };                        // In chunks.
 
             vulkan::buffer<gpu_world_config> gpu_world_conf;
             gpu_world_config world_conf{};
 
-            vulkan::buffer<gpu_index_pointers> gpu_world_index_ptrs;
-            gpu_index_pointers world_index_ptrs{};
-
-            vulkan::buffer<gpu_brick_pointers> gpu_world_brick_ptrs;
-            gpu_brick_pointers world_brick_ptrs{};
-
-            vulkan::buffer<gpu_brick_load_queue> bricks_requested_by_gpu;
-            vulkan::buffer<brick> gpu_bricks_to_load;
-            vulkan::buffer<uint32_t> gpu_indices_to_load;
+            vulkan::buffer<cell_index> gpu_index_heap;      // The GPU indices of every chunk.
+
+            // Device addresses of each chunk's indices, one per chunk.
+            vulkan::buffer<uint64_t> gpu_world_index_ptrs;
+            std::vector<uint64_t> world_index_ptrs;
+
+            // One bit per chunk, chunk i in bit i % 32 of word i / 32, set when chunk::has_cells. Kept up to date by upload_edits.
+            vulkan::buffer<uint32_t> gpu_chunk_occupancy;
+            std::vector<uint32_t> chunk_occupancy;
+
+            // Distance of every cell to the nearest one that is not empty. The GPU has it in the LOD word of its empty cells.
+            cell_distance_field cell_distances;
+
+            // Every GPU resident brick of every chunk. Loads take a slot and never grow or move the heap.
+            vulkan::buffer<brick> gpu_brick_heap;
+            brick_slot_allocator brick_slots;
+            vulkan::buffer<uint32_t> gpu_brick_stamps;      // Last frame each heap slot was traversed, written by the ray tracer.
+            vulkan::buffer<uint32_t> gpu_brick_stamp_readback;  // Host copy of gpu_brick_stamps, taken before each eviction pass.
+            vulkan::buffer<uint64_t> gpu_brick_occupancy;   // brick_occupancy_4x4x4 of each heap slot, written with the brick.
+
+            // Materials only grow with the bricks on the GPU. Each heap slot has its palette, and bricks with more than one material a block of
+            // per voxel palette entries, taken from a heap of their own. The shade kernel reads them for the voxels rays hit.
+            material_colors colors = make_terrain_colors();
+            vulkan::buffer<uint32_t> gpu_material_colors;
+            vulkan::buffer<gpu_brick_material> gpu_brick_materials;
+            vulkan::buffer<uint32_t> gpu_material_indices;
+            brick_slot_allocator material_blocks;
+            std::vector<uint32_t> slot_material_blocks;     // Block + 1 of each heap slot's brick, 0 for none.
+
+            vulkan::buffer<gpu_brick_load_queue> bricks_requested_by_gpu;   // brick_request_queue_count queues, one per trace in flight.
+            vulkan::buffer<uint32_t> gpu_brick_payloads;    // Encoded bricks to place, decoded by world_upload_bricks.comp. See brick_codec.h.
+            vulkan::buffer<gpu_brick_placement> gpu_placements;
             uint32_t oubound_bricks{};
 
             vk::Pipeline upload_bricks_pipeline;
             vk::PipelineLayout upload_bricks_layout;
             vk::DescriptorSet upload_set;
 
-            uint32_t stat_brick_loads {};
+            volume_import_stats import_stats;
+            bool brick_compression {};
+            brick_dedup_stats dedup_stats;                  // CPU side statistics. The GPU counters are kept by the streaming thread.
             bool load_queue_initialized {};
 
+            // Render thread side of streaming.
+            brick_streaming_settings streaming_settings;
+            std::vector<voxel_edit> pending_edits;          // Made since the last tick.
+            brick_streaming_stats streamed;                 // Latest statistics received from the streaming thread.
+            uint32_t request_capacity { brick_default_request_capacity };    // Only read by the ray tracer, the streaming thread takes what the queue holds.
+
+            // Shared between the render and streaming threads.
+            util::spsc_queue<brick_streaming_settings, 8> settings_queue;
+            util::spsc_queue<brick_streaming_stats, 8> stats_queue;
+            std::atomic<uint64_t> traced_frames {};         // world_frame as last published by the render thread.
+            std::atomic<bool> streaming_quit {};
+            std::mutex edit_mutex;
+            std::vector<voxel_edit> queued_edits;           // Handed over by tick, guarded by edit_mutex.
+            std::thread streaming_thread;
+
+            // Streaming thread side. Everything brick loading touches below is only used by the streaming thread while it runs.
+            brick_streaming_settings stream_settings;
+            brick_streaming_stats stream_stats;
+            uint64_t stream_frame {};                       // The next traced frame to service.
+            uint32_t serviced_queue {};                     // Request queue of stream_frame.
+
+            struct edited_cell
+            {
+                uint64_t key;                               // Chunk index in the high half, cell in the low half.
+                bool was_resident;                          // The cell's brick was on the GPU before the edit, so the edited brick is uploaded right away.
+            };
+
+            // What editing one chunk produced, merged once every chunk of a batch is done.
+            struct chunk_edit_output
+            {
+                std::vector<edited_cell> cells;
+                std::vector<uint32_t> released_slots;       // Heap slots of bricks no cell uses any more.
+                uint64_t copied_bricks {};
+                uint64_t touched_bricks {};
+            };
+
+            std::vector<voxel_edit> deferred_edits;         // Parts of edits whose chunk is being paged in.
+            std::vector<edited_cell> edited_cells;
+
             // Synchronization objects for loading bricks onto the GPU.
             // I don't completely understand timeline semaphores yet and it is probably possible to do this with fewer semaphores or an entirely different sync design.
             // After the ray tracer completes a pass, bricks_requested_by_gpu is valid to be read once transfers complete. This must be synchronized.
-            // We then do any necessary reallocations and send the bricks to the GPU to be processed, which also needs to be synchronzied.
+            // We then send the bricks to the GPU to be processed, which also needs to be synchronzied.
             // When that's done, we allow the ray tracer to continue.
+            // All of this runs on the streaming thread, which owns the transfer and compute queues. The render thread only submits waits and signals.
             vk::CommandBuffer brick_loader_cmd;
             vk::CommandPool brick_loader_command_pool;
+            vk::CommandBuffer brick_stamp_cmd;
+            vk::Fence brick_stamp_fence;
             vk::CommandBuffer brick_processor_cmd;
             vk::CommandPool brick_processor_command_pool;
-            vk::Semaphore brick_load_semaphore;                     // ... indicates we are busy writing / transferring gpu_bricks_to_load / gpu_indices_to_load (CPU to GPU buffers)
-            vk::Semaphore brick_proc_semaphore;                     // ... indicates we are reallocating brick buffers or executing the compute operation to place the uploaded bricks.
+            vk::Semaphore brick_load_semaphore;                     // ... indicates we are busy writing / transferring gpu_brick_payloads / gpu_placements (CPU to GPU buffers)
+            vk::Semaphore brick_proc_semaphore;                     // ... indicates we are executing the compute operation to place the uploaded bricks.
             vk::Semaphore brick_halt_semaphore;                     // ... indicates the ray tracer is busy ... prevents the world from checking the requested bricks count which will not be stable until after tracing & transfer.
             util::deletion_queue brick_loader_deletion_queue;
             uint64_t loader_frames{};
             uint64_t proc_frames{};
-            uint64_t world_frame{};
+            uint64_t world_frame{};                                 // Render thread frame, the value the next trace signals.
 
             vulkan::render_context* render_ctx {};
             vulkan::device_context* device_ctx {};
             std::shared_ptr<vulkan::worker> worker;
 
-            uint64_t filled_voxels{};
+            std::atomic<uint64_t> filled_voxels {};        // Edits on the streaming thread update it too.
         };
 
     }
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+// On-disk brickmap format.
+//
+// [world_file_header]
+// [uint32_t x material_count]              material colors, identical to world::colors
+// [world_file_chunk x chunk_count]         chunk table, indexed by chunk index
+// per chunk, each array aligned to world_file_alignment:
+//     [cell_index x index_count]           chunk indices, identical to chunk::indices
+//     [brick x brick_count]                chunk bricks, identical to chunk::bricks
+//     [brick_material x brick_count]       brick materials, identical to chunk::materials
+//     [uint32_t x material_index_count]    palette entries, identical to chunk::material_indices
+//
+// Arrays are stored exactly as they are laid out in memory so a mapped file can back chunk::indices, chunk::bricks and the materials directly.
+// Bump world_file_version whenever the layout of the header, chunk table, indices, bricks or materials changes.
+
+namespace rebel_road
+{
+    namespace voxel
+    {
+        constexpr static uint32_t world_file_magic = 0x50414D42u;     // "BMAP"
+        constexpr static uint32_t world_file_version = 3;
+        constexpr static uint64_t world_file_alignment = 64;
+
+        struct world_file_header
+        {
+            uint32_t magic { world_file_magic };
+            uint32_t version { world_file_version };
+            int32_t grid_size {};
+            int32_t grid_height {};
+            int32_t chunk_size {};
+            int32_t brick_size {};
+            uint32_t chunk_count {};
+            uint32_t pad0 {};
+            uint64_t filled_voxels {};
+            uint64_t chunk_table_offset {};
+            uint64_t material_colors_offset {};
+        };
+
+        struct world_file_chunk
+        {
+            uint64_t index_offset {};
+            uint64_t brick_offset {};
+            uint32_t index_count {};
+            uint32_t brick_count {};
+            uint64_t filled_voxels {};
+            uint64_t material_offset {};
+            uint64_t material_index_offset {};
+            uint32_t material_index_count {};
+            uint32_t pad0 {};
+        };
+
+        constexpr uint64_t world_file_align( uint64_t offset )
+        {
+            return ( offset + world_file_alignment - 1 ) & ~( world_file_alignment - 1 );
+        }
+    }
+}
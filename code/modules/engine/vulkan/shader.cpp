@@ -257,7 +257,7 @@ namespace rebel_road
 			return pipeline_stages;
 		}
 
-        std::pair<vk::Pipeline, vk::PipelineLayout> load_compute_shader( const std::string& shader_path, device_context* device_ctx )
+        std::pair<vk::Pipeline, vk::PipelineLayout> load_compute_shader( const std::string& shader_path, device_context* device_ctx, const vk::SpecializationInfo* specialization )
         {
             // fixme: we should cache these modules
             vulkan::shader_module* compute_module = device_ctx->create_shader_module( shader_path );
@@ -270,6 +270,7 @@ namespace rebel_road
 
 			vk::ComputePipelineCreateInfo pipeline_info {};
 			pipeline_info.stage = pipeline_shader_stage_create_info( vk::ShaderStageFlagBits::eCompute, compute_module->module );
+			pipeline_info.stage.pSpecializationInfo = specialization;
 			pipeline_info.layout = layout;
 
 			vk::Pipeline pipeline = device_ctx->create_compute_pipeline( pipeline_info );
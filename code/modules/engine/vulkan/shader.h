@@ -82,6 +82,7 @@ namespace rebel_road
             device_context* device_ctx {};
         };
 
-        std::pair<vk::Pipeline, vk::PipelineLayout> load_compute_shader( const std::string& shader_path, device_context* device_ctx );
+        // specialization optionally sets the shader's specialization constants.
+        std::pair<vk::Pipeline, vk::PipelineLayout> load_compute_shader( const std::string& shader_path, device_context* device_ctx, const vk::SpecializationInfo* specialization = nullptr );
     }
 }
\ No newline at end of file
@@ -1,39 +1,50 @@
 const int brick_size = 8;
 const int cell_members = brick_size * brick_size * brick_size / 32;
-const int brick_load_queue_size = 1024;
-const uint brick_index_bits = 0xFFFu;
-const uint brick_lod_bits = 0xFF000u;
+const int brick_load_queue_size = 16384;
+const uint brick_request_queue_count = 2;
+// Cell indices are uvec2, see world.h. x holds the flags and brick index, y the LOD byte and an empty cell's distance to the nearest occupied one,
+// or the material of a solid cell or of the most common material of a cell's brick.
+const uint brick_index_bits = 0x00FFFFFFu;
+const uint brick_flag_bits = 0xFF000000u;
+const uint brick_lod_bits = 0x000000FFu;
+const uint brick_distance_bits = 0x0000FF00u;
+const uint brick_distance_shift = 8;
+const uint brick_material_bits = 0x0000FF00u;
+const uint brick_material_shift = 8;
 const uint brick_loaded_bit = 0x80000000u;
 const uint brick_unloaded_bit = 0x40000000u;
 const uint brick_requested_bit = 0x20000000u;
+const uint brick_solid_bit = 0x10000000u;
+const uint brick_no_payload = 0xFFFFFFFFu;
+// A 2 bit palette entry per voxel of a brick with more than one material, see material.h.
+const int material_index_words = brick_size * brick_size * brick_size * 2 / 32;
 
 struct brick
 {
     uint data[cell_members];
 };
 
-const int MAX_BOUNCES = 3;
-
-/*
-const int grid_size = 4096;//128;
-const int grid_height = 128;//128;
-
-const int chunk_size = 16;
-const int supergrid_xy = grid_size / brick_size / chunk_size;
-const int supergrid_z = grid_height / brick_size / chunk_size;
-
-const int supergrid_starting_size = 16;
-
-const int cells = grid_size / brick_size;
-const int cells_height = grid_height / brick_size;
-// The amount of uint32_t members holding voxel bit data
-const int world_size = supergrid_xy * supergrid_xy * supergrid_z;
-
-// LoD distance for blocksize 1x1x1 representing 8x8x8
-const int lod_distance_8x8x8 = 600000;
-// LoD distance for blocksize 2x2x2 representing 8x8x8
-const int lod_distance_2x2x2 = 100000;
+// Matches gpu_brick_placement in world.h.
+struct brick_placement
+{
+    uint index;
+    uint payload;
+    uint palette;
+    uint material_block;	// Block + 1 of material_indices, 0 when the brick has one material.
+};
 
+// Matches gpu_brick_load_queue in world.h.
+struct brick_request_queue
+{
+	uint load_queue_count;	// Requests the trace tried to queue, which may be past request_capacity.
+	uint request_capacity;	// Of the trace that filled the queue, written by world::record_request_capacity.
+	uint padlq1;
+	uint padlq2;
+	ivec4 bricks_to_load[brick_load_queue_size];	// Brick position and priority, the squared distance to the camera in bricks.
+};
 
-*/
+const int MAX_BOUNCES = 3;
 
+// The chunk size baked in by the host for the common sizes, so the traversal divides by a constant.
+// 0 for the generic path, which reads chunk_size from world_config.
+layout ( constant_id = 0 ) const int chunk_size_fast = 0;
@@ -21,6 +21,7 @@ layout (push_constant) uniform push_constants
     uint enable_depth_of_field;
     uint render_mode;
     vec2 sun_position;
+    uint request_capacity;
 };
 
 layout (set = 0, binding = 0) buffer blit_buffer